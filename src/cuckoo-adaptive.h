@@ -0,0 +1,226 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <iostream>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+
+#include "cuckoo-serial.h"
+
+/**
+ * CuckooSerialHashSet that only synchronizes while more than one thread uses
+ * it. Threads attach() before their first operation and detach() after
+ * their last. While at most one thread is attached, operations run the
+ * serial engine directly, with no lock and no atomic read-modify-write.
+ * The second attach() switches the set to shared mode, where lookups take a
+ * reader-writer lock shared and writes take it exclusive; the set switches
+ * back once a single thread is left.
+ *
+ * The switch waits for the solo thread's operation in flight to finish. The
+ * solo thread flags each operation with a plain store and checks the mode
+ * after it. The switching thread publishes the mode and then issues
+ * membarrier(2), which runs a full barrier on every running thread of the
+ * process, so one of the two sees the other's write. The fast path
+ * therefore needs only a compiler barrier. Where the kernel lacks
+ * membarrier, the solo thread pays a full fence per operation instead.
+ *
+ * Shared mode uses one lock for the whole table: the serial engine's
+ * displacement and resize touch slots anywhere in it.
+ */
+template <class T>
+class CuckooAdaptiveHashSet {
+    CuckooSerialHashSet<T> set;
+    std::shared_mutex lock;
+    // Serializes attach() and detach()
+    std::mutex transition;
+    int attached = 0;
+    std::atomic<bool> shared{false};
+    // Set by the solo thread while it runs an operation unlocked
+    alignas(64) std::atomic<bool> in_op{false};
+    const bool use_fence;
+
+    /**
+     * return: true if membarrier can order the solo thread's operations,
+     * checked once per process
+     */
+    static bool expedited_barrier() {
+        static const bool available =
+            syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+        return available;
+    }
+
+    /**
+     * Orders the caller's last store before its next load on every running
+     * thread of the process, as if each had run a full fence
+     */
+    void heavy_barrier() {
+        if (use_fence)
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        else
+            syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+    }
+
+    /**
+     * return: true if the caller may run its operation unlocked, in which
+     * case it calls leave_solo() after
+     */
+    bool enter_solo() {
+        in_op.store(true, std::memory_order_relaxed);
+        if (use_fence)
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        else
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        if (!shared.load(std::memory_order_acquire))
+            return true;
+        in_op.store(false, std::memory_order_release);
+        return false;
+    }
+
+    void leave_solo() {
+        in_op.store(false, std::memory_order_release);
+    }
+
+    template <class Fn>
+    auto read(const Fn &fn) -> decltype(fn()) {
+        if (enter_solo()) {
+            auto result = fn();
+            leave_solo();
+            return result;
+        }
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return fn();
+    }
+
+    template <class Fn>
+    auto write(const Fn &fn) -> decltype(fn()) {
+        if (enter_solo()) {
+            auto result = fn();
+            leave_solo();
+            return result;
+        }
+        std::unique_lock<std::shared_mutex> guard(lock);
+        return fn();
+    }
+
+    public:
+        CuckooAdaptiveHashSet(int capacity) : set(capacity), use_fence(!expedited_barrier()) {}
+
+        /**
+         * Registers the calling thread. Must come before its first
+         * operation once other threads may use the set. The second thread
+         * attached waits for an operation of the first in flight.
+         */
+        void attach() {
+            std::lock_guard<std::mutex> guard(transition);
+            if (++attached != 2)
+                return;
+            shared.store(true);
+            heavy_barrier();
+            while (in_op.load())
+                std::this_thread::yield();
+        }
+
+        /**
+         * Unregisters the calling thread. Must come after its last
+         * operation.
+         */
+        void detach() {
+            std::lock_guard<std::mutex> guard(transition);
+            if (--attached == 1)
+                shared.store(false, std::memory_order_release);
+        }
+
+        /**
+         * return: true while operations run unlocked
+         */
+        bool solo() {
+            return !shared.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Adds val
+         * return: true if add was successful
+         */
+        bool add(const T &val) {
+            return write([&]() { return set.add(val); });
+        }
+
+        bool add(T &&val) {
+            return write([&]() { return set.add(std::move(val)); });
+        }
+
+        /**
+         * Builds a value from args and adds it by move. The value is
+         * hashed and compared before it has a slot, so it is not
+         * constructed in place.
+         * return: true if add was successful
+         */
+        template <class... Args>
+        bool emplace(Args&&... args) {
+            return add(T(std::forward<Args>(args)...));
+        }
+
+        /**
+         * Removes val
+         * return: true if remove was successful
+         */
+        bool remove(const T &val) {
+            return write([&]() { return set.remove(val); });
+        }
+
+        /**
+         * Removes the value equal to key, see is_heterogeneous_key
+         * return: true if remove was successful
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool remove(const K &key) {
+            return write([&]() { return set.remove(key); });
+        }
+
+        /**
+         * Checks if the table contains val
+         * return: true if the table contains val
+         */
+        bool contains(const T &val) {
+            return read([&]() { return set.contains(val); });
+        }
+
+        /**
+         * Checks if the table contains a value equal to key, see
+         * is_heterogeneous_key
+         * return: true if the table contains it
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool contains(const K &key) {
+            return read([&]() { return set.contains(key); });
+        }
+
+        /**
+         * return: The number of elements in the table
+         */
+        int size() {
+            return read([&]() { return set.size(); });
+        }
+
+        /**
+         * return: The share of the table's slots in use
+         */
+        double load_factor() {
+            return read([&]() { return set.load_factor(); });
+        }
+
+        /**
+         * Populates the table to some predetermined size
+         * return: true if successful
+         */
+        bool populate(const std::vector<T> &entries) {
+            return write([&]() { return set.populate(entries); });
+        }
+};
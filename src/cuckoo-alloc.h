@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Allocator for the engines' bucket arrays. Large arrays are mapped directly
+ * from the kernel, aligned to the page size in use, optionally on huge pages
+ * to cut the TLB misses of the two random bucket probes, and optionally
+ * pre-faulted so the page faults of a new table are taken in one go when it
+ * is allocated rather than one by one while resize() fills it. Small
+ * requests (such as list nodes) go to cache-line aligned operator new.
+ */
+
+enum class PageMode {
+    // Regular pages
+    Small,
+    // Transparent huge pages: a huge page aligned mapping with
+    // madvise(MADV_HUGEPAGE)
+    Transparent,
+    // Reserved hugetlbfs pages (MAP_HUGETLB). Falls back to Transparent when
+    // none are free.
+    Huge
+};
+
+struct TableMemory {
+    PageMode pages = PageMode::Small;
+    bool prefault = false;
+
+    bool operator==(const TableMemory &other) const {
+        return pages == other.pages && prefault == other.prefault;
+    }
+};
+
+/**
+ * How the mappings made so far were actually backed, for reports
+ */
+struct TableMemoryStats {
+    std::atomic<long> small{0};
+    std::atomic<long> transparent{0};
+    std::atomic<long> huge{0};
+};
+
+inline TableMemoryStats &table_memory_stats() {
+    static TableMemoryStats stats;
+    return stats;
+}
+
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+// Requests below this size are not worth a mapping of their own
+const size_t MAPPED_MIN = 64 << 10;
+const size_t CACHE_LINE = 64;
+
+inline size_t table_page_size(PageMode pages) {
+    static const size_t small_page = sysconf(_SC_PAGESIZE);
+    return pages == PageMode::Small ? small_page : HUGE_PAGE_SIZE;
+}
+
+inline size_t round_up(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Maps bytes of zeroed memory aligned to the page size of memory.pages
+ * return: the mapping, or nullptr if the kernel refused
+ */
+inline void *map_table(size_t bytes, TableMemory memory) {
+    int populate = memory.prefault ? MAP_POPULATE : 0;
+    size_t length = round_up(bytes, table_page_size(memory.pages));
+    if (memory.pages == PageMode::Huge) {
+        void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+        if (p != MAP_FAILED) {
+            table_memory_stats().huge++;
+            return p;
+        }
+    }
+    if (memory.pages == PageMode::Small) {
+        void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | populate, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+        table_memory_stats().small++;
+        return p;
+    }
+
+    // Over-map by a huge page and trim both ends so the region is aligned,
+    // which THP needs to back it with huge pages
+    size_t padded = length + HUGE_PAGE_SIZE;
+    char *raw = (char*) mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return nullptr;
+    char *aligned = (char*) round_up((uintptr_t) raw, HUGE_PAGE_SIZE);
+    if (aligned != raw)
+        munmap(raw, aligned - raw);
+    size_t tail = (raw + padded) - (aligned + length);
+    if (tail != 0)
+        munmap(aligned + length, tail);
+    madvise(aligned, length, MADV_HUGEPAGE);
+    if (memory.prefault) {
+        // One write per huge page faults it in whole
+        for (size_t offset = 0; offset < length; offset += HUGE_PAGE_SIZE)
+            ((volatile char*) aligned)[offset] = 0;
+    }
+    table_memory_stats().transparent++;
+    return aligned;
+}
+
+/**
+ * Unmaps a region returned by map_table(bytes, memory)
+ */
+inline void unmap_table(void *p, size_t bytes, TableMemory memory) {
+    // Huge falls back to Transparent, both use the huge page size
+    munmap(p, round_up(bytes, table_page_size(memory.pages)));
+}
+
+/**
+ * Standard allocator over map_table, usable with any container. Copies and
+ * rebinds carry the TableMemory settings.
+ */
+template <class T>
+class TableAllocator {
+    public:
+        using value_type = T;
+
+        TableMemory memory;
+
+        TableAllocator(TableMemory memory = TableMemory()) noexcept : memory(memory) {}
+
+        template <class U>
+        TableAllocator(const TableAllocator<U> &other) noexcept : memory(other.memory) {}
+
+        T *allocate(size_t n) {
+            size_t bytes = n * sizeof(T);
+            if (bytes < MAPPED_MIN)
+                return static_cast<T*>(::operator new(bytes, std::align_val_t(CACHE_LINE)));
+            void *p = map_table(bytes, memory);
+            if (p == nullptr)
+                throw std::bad_alloc();
+            return static_cast<T*>(p);
+        }
+
+        void deallocate(T *p, size_t n) noexcept {
+            size_t bytes = n * sizeof(T);
+            if (bytes < MAPPED_MIN)
+                ::operator delete(p, std::align_val_t(CACHE_LINE));
+            else
+                unmap_table(p, bytes, memory);
+        }
+
+        template <class U>
+        bool operator==(const TableAllocator<U> &other) const {
+            return memory == other.memory;
+        }
+
+        template <class U>
+        bool operator!=(const TableAllocator<U> &other) const {
+            return !(memory == other.memory);
+        }
+};
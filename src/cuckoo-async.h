@@ -0,0 +1,281 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <iostream>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+
+#include "cuckoo-concurrent.h"
+
+/**
+ * Bounded lock-free queue for many producers and one consumer, after
+ * Vyukov's bounded MPMC queue: every cell carries a sequence number telling
+ * producers and the consumer whose turn it is, so a push is one CAS on the
+ * tail and no cell is shared by two operations at once.
+ */
+template <class Op>
+class MpscRing {
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence;
+        Op op;
+    };
+
+    std::vector<Cell> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail;
+    // Only the consumer moves head
+    alignas(64) size_t head;
+
+    public:
+        /**
+         * capacity: rounded up to a power of 2
+         */
+        MpscRing(size_t capacity) : tail(0), head(0) {
+            size_t size = 2;
+            while (size < capacity)
+                size *= 2;
+            cells = std::vector<Cell>(size);
+            for (size_t i = 0; i < size; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            mask = size - 1;
+        }
+
+        /**
+         * return: the position op was queued at (its ticket), or -1 if the
+         * queue is full
+         */
+        long try_push(const Op &op) {
+            size_t pos = tail.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell &cell = cells[pos & mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                long diff = (long) sequence - (long) pos;
+                if (diff == 0) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    return -1;
+                } else {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+            Cell &cell = cells[pos & mask];
+            cell.op = op;
+            cell.sequence.store(pos + 1, std::memory_order_release);
+            return pos;
+        }
+
+        /**
+         * Consumer only
+         * return: true if an op was taken
+         */
+        bool try_pop(Op &op) {
+            Cell &cell = cells[head & mask];
+            if (cell.sequence.load(std::memory_order_acquire) != head + 1)
+                return false;
+            op = std::move(cell.op);
+            cell.sequence.store(head + mask + 1, std::memory_order_release);
+            head++;
+            return true;
+        }
+
+        /**
+         * return: the position the next push will get
+         */
+        size_t next_ticket() {
+            return tail.load(std::memory_order_acquire);
+        }
+};
+
+/**
+ * Write-behind front-end over CuckooConcurrentHashSet. add_async and
+ * remove_async queue the write and return at once; applier threads drain the
+ * queues in batches into the set. Writes are sharded over the queues by key,
+ * so writes to one key from one producer are applied in the order they were
+ * queued. Reads go straight to the set and see queued writes only once
+ * applied; flush() waits for everything queued before it.
+ */
+template <class T>
+class CuckooAsyncHashSet {
+    static const int BATCH_SIZE = 64;
+    static const int IDLE_SPINS = 256;
+    static const int PUSH_SPINS_BEFORE_YIELD = 64;
+
+    enum OpType { ADD, REMOVE };
+
+    struct Op {
+        int type;
+        T val;
+        Op() : type(ADD), val() {}
+        Op(int type, const T &val) : type(type), val(val) {}
+    };
+
+    struct alignas(64) Shard {
+        MpscRing<Op> queue;
+        // Tickets below this have been applied
+        std::atomic<size_t> applied;
+        Shard(size_t capacity) : queue(capacity), applied(0) {}
+    };
+
+    CuckooConcurrentHashSet<T> set;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<std::thread> appliers;
+    std::atomic<bool> stopping;
+    std::atomic<long> failed;
+    std::atomic<long> full_waits;
+
+    Shard &shard_for(const T &val) {
+        return *shards[std::hash<T>()(val) % shards.size()];
+    }
+
+    void enqueue(int type, const T &val) {
+        Shard &shard = shard_for(val);
+        Op op(type, val);
+        if (shard.queue.try_push(op) >= 0)
+            return;
+        // Queue full, wait for the applier to make room
+        full_waits++;
+        for (int spins = 0; shard.queue.try_push(op) < 0; spins++) {
+            if (spins >= PUSH_SPINS_BEFORE_YIELD)
+                std::this_thread::yield();
+        }
+    }
+
+    void apply(Shard &shard) {
+        int idle = 0;
+        Op op;
+        for (;;) {
+            int batch = 0;
+            while (batch < BATCH_SIZE && shard.queue.try_pop(op)) {
+                bool ok = op.type == ADD ? set.add(std::move(op.val)) : set.remove(op.val);
+                if (!ok)
+                    failed.fetch_add(1, std::memory_order_relaxed);
+                batch++;
+            }
+            if (batch > 0) {
+                shard.applied.fetch_add(batch, std::memory_order_release);
+                idle = 0;
+                continue;
+            }
+            if (stopping.load(std::memory_order_acquire))
+                return;
+            if (++idle < IDLE_SPINS)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    public:
+        /**
+         * capacity: initial capacity of the set
+         * appliers: applier threads, each draining its own queue
+         * queue_capacity: writes each queue holds before add_async and
+         * remove_async block
+         */
+        CuckooAsyncHashSet(int capacity, int appliers = 1, int queue_capacity = 1 << 16)
+            : set(capacity), stopping(false), failed(0), full_waits(0) {
+            for (int i = 0; i < appliers; i++)
+                shards.emplace_back(new Shard(queue_capacity));
+            for (int i = 0; i < appliers; i++) {
+                Shard *shard = shards[i].get();
+                this->appliers.emplace_back([this, shard]() { apply(*shard); });
+            }
+        }
+
+        /**
+         * Applies every queued write, then stops the appliers
+         */
+        ~CuckooAsyncHashSet() {
+            flush();
+            stopping.store(true, std::memory_order_release);
+            for (auto &applier : appliers)
+                applier.join();
+        }
+
+        /**
+         * Queues an add of val. Blocks only while val's queue is full.
+         */
+        void add_async(const T &val) {
+            enqueue(ADD, val);
+        }
+
+        /**
+         * Queues a remove of val. Blocks only while val's queue is full.
+         */
+        void remove_async(const T &val) {
+            enqueue(REMOVE, val);
+        }
+
+        /**
+         * Waits until every write queued before the call has been applied
+         */
+        void flush() {
+            for (auto &shard : shards) {
+                size_t target = shard->queue.next_ticket();
+                while (shard->applied.load(std::memory_order_acquire) < target)
+                    std::this_thread::yield();
+            }
+        }
+
+        /**
+         * Adds val synchronously, bypassing the queues
+         * return: true if add was successful
+         */
+        bool add(const T &val) {
+            return set.add(val);
+        }
+
+        /**
+         * Removes val synchronously, bypassing the queues
+         * return: true if remove was successful
+         */
+        bool remove(const T &val) {
+            return set.remove(val);
+        }
+
+        /**
+         * Checks if the table contains val. Queued writes are not visible
+         * until applied.
+         * return: true if the table contains val
+         */
+        bool contains(const T &val) {
+            return set.contains(val);
+        }
+
+        /**
+         * return: Queued writes that had no effect (add of a present value,
+         * remove of an absent one)
+         */
+        long failed_writes() {
+            return failed;
+        }
+
+        /**
+         * return: Writes that found their queue full and had to wait
+         */
+        long backpressure_waits() {
+            return full_waits;
+        }
+
+        /**
+         * return: The number of elements in the table, not counting writes
+         * still queued
+         */
+        int size() {
+            return set.size();
+        }
+
+        /**
+         * Populates the table to some predetermined size
+         * Thread non-safe!
+         * return: true if successful
+         */
+        bool populate(const std::vector<T> &entries) {
+            return set.populate(entries);
+        }
+};
@@ -0,0 +1,649 @@
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <math.h>
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+
+#include "cuckoo-serial.h"
+#include "cuckoo-concurrent.h"
+#include "cuckoo-transactional.h"
+#include "cuckoo-adaptive.h"
+#include "unordered-set-baseline.h"
+#include "cuckoo-alloc.h"
+#include "perf-counters.h"
+
+/**
+ * Microbenchmarks for each set operation in isolation. Every benchmark
+ * builds a fresh set outside the timed region, times one operation kind over
+ * a fixed key set, and is repeated to report median/min/mean/stddev.
+ */
+
+const int DEFAULT_KEYS = 100000;
+const int DEFAULT_REPS = 11;
+const int WARMUP_REPS = 1;
+const unsigned KEY_SEED = 375;
+// Length range of the string keys
+const int STRING_KEY_MIN = 16;
+const int STRING_KEY_MAX = 256;
+const int SIZE_POLLS = 1000;
+// Displacements allowed to each try_add in the tail latency suite
+const int TRY_ADD_BUDGET = 16;
+// Round trips between solo and shared mode timed on the adaptive set
+const int MODE_SWITCHES = 1000;
+
+struct Stats {
+    double median = 0;
+    double min = 0;
+    double mean = 0;
+    double stddev = 0;
+};
+
+// Keeps lookup results alive so the timed loops are not optimized away
+volatile long sink = 0;
+
+/**
+ * Constructor argument that gives a set room for keys at its design load:
+ * the serial layout has two slots per index and tops out near 50% load, the
+ * concurrent layout keeps THRESHOLD (4) entries in each of two probe sets.
+ */
+template <class Set>
+struct Sizing {
+    static int capacity(int keys) { return std::max(1, keys); }
+};
+
+template <class T, bool CACHE_HASH>
+struct Sizing<CuckooConcurrentHashSet<T, CACHE_HASH>> {
+    static int capacity(int keys) { return std::max(1, keys / 8); }
+};
+
+/**
+ * CuckooAdaptiveHashSet holding two attachments for its lifetime, so every
+ * operation takes the locked path it takes while two threads share the set
+ */
+template <class T>
+struct SharedAdaptiveHashSet : CuckooAdaptiveHashSet<T> {
+    SharedAdaptiveHashSet(int capacity) : CuckooAdaptiveHashSet<T>(capacity) {
+        this->attach();
+        this->attach();
+    }
+};
+
+class Timer {
+    std::chrono::high_resolution_clock::time_point begin;
+    long long elapsed_ns = 0;
+
+    public:
+        void start() {
+            begin = std::chrono::high_resolution_clock::now();
+        }
+
+        void stop() {
+            elapsed_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::high_resolution_clock::now() - begin).count();
+        }
+
+        long long elapsed() {
+            return elapsed_ns;
+        }
+};
+
+/**
+ * Runs fn WARMUP_REPS + reps times. fn builds its own state and times only
+ * the region between Timer::start and Timer::stop.
+ * return: nanoseconds per operation over the measured repetitions
+ */
+Stats measure(int reps, long ops, const std::function<void(Timer&)> &fn) {
+    std::vector<double> samples;
+    for (int rep = 0; rep < WARMUP_REPS + reps; rep++) {
+        Timer timer;
+        fn(timer);
+        if (rep >= WARMUP_REPS)
+            samples.push_back((double) timer.elapsed() / ops);
+    }
+    std::sort(samples.begin(), samples.end());
+    Stats stats;
+    stats.min = samples.front();
+    stats.median = samples[samples.size() / 2];
+    for (double sample : samples)
+        stats.mean += sample / samples.size();
+    for (double sample : samples)
+        stats.stddev += (sample - stats.mean) * (sample - stats.mean) / samples.size();
+    stats.stddev = sqrt(stats.stddev);
+    return stats;
+}
+
+bool csv = false;
+
+void report(const char *impl, const char *bench, Stats stats) {
+    if (csv) {
+        std::cout << impl << "," << bench << "," << stats.median << "," << stats.min << ","
+                  << stats.mean << "," << stats.stddev << std::endl;
+        return;
+    }
+    std::cout << std::left << std::setw(22) << impl << std::setw(18) << bench << std::right << std::fixed
+              << std::setprecision(2) << std::setw(12) << stats.median << std::setw(12) << stats.min
+              << std::setw(12) << stats.mean << std::setw(12) << stats.stddev
+              << std::setprecision(0) << std::setw(16) << 1e9 / stats.median << std::endl;
+}
+
+void check_size(const char *impl, const char *bench, int expected, int actual) {
+    if (expected != actual)
+        std::cerr << impl << " " << bench << ": expected size " << expected << ", got " << actual << std::endl;
+}
+
+/**
+ * Generates num_entries unique keys from a fixed seed
+ */
+std::vector<int> generate_keys(int num_entries, std::mt19937 &generator) {
+    std::uniform_int_distribution<int> key_generator(0, 1 << 30);
+    std::unordered_set<int> seen;
+    std::vector<int> keys;
+    while ((int) keys.size() < num_entries) {
+        int key = key_generator(generator);
+        if (seen.insert(key).second)
+            keys.push_back(key);
+    }
+    return keys;
+}
+
+/**
+ * Generates num_entries unique strings of STRING_KEY_MIN to STRING_KEY_MAX
+ * printable characters
+ */
+std::vector<std::string> generate_string_keys(int num_entries, std::mt19937 &generator) {
+    std::uniform_int_distribution<int> length_generator(STRING_KEY_MIN, STRING_KEY_MAX);
+    std::uniform_int_distribution<int> char_generator('!', '~');
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> keys;
+    while ((int) keys.size() < num_entries) {
+        std::string key(length_generator(generator), ' ');
+        for (char &c : key)
+            c = char_generator(generator);
+        if (seen.insert(key).second)
+            keys.push_back(key);
+    }
+    return keys;
+}
+
+template <class Set, class Key>
+void run_suite(const char *impl, const std::vector<Key> &keys, const std::vector<Key> &absent, int reps) {
+    int n = keys.size();
+    int room = Sizing<Set>::capacity(2 * n);
+
+    report(impl, "contains_hit", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        long hits = 0;
+        timer.start();
+        for (const Key &key : keys)
+            hits += set.contains(key);
+        timer.stop();
+        sink += hits;
+        check_size(impl, "contains_hit", n, hits);
+    }));
+
+    report(impl, "contains_miss", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        long hits = 0;
+        timer.start();
+        for (const Key &key : absent)
+            hits += set.contains(key);
+        timer.stop();
+        sink += hits;
+        check_size(impl, "contains_miss", 0, hits);
+    }));
+
+    // Starts at zero load and stays under a quarter of the design load
+    report(impl, "add_empty", measure(reps, n, [&](Timer &timer) {
+        Set set(Sizing<Set>::capacity(4 * n));
+        timer.start();
+        for (const Key &key : keys)
+            set.add(key);
+        timer.stop();
+        check_size(impl, "add_empty", n, set.size());
+    }));
+
+    // Fills the last 20% up to the design load
+    int prefill = n * 4 / 5;
+    std::vector<Key> head(keys.begin(), keys.begin() + prefill);
+    report(impl, "add_near_full", measure(reps, n - prefill, [&](Timer &timer) {
+        Set set(Sizing<Set>::capacity(n));
+        set.populate(head);
+        timer.start();
+        for (int i = prefill; i < n; i++)
+            set.add(keys[i]);
+        timer.stop();
+        check_size(impl, "add_near_full", n, set.size());
+    }));
+
+    report(impl, "remove", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        timer.start();
+        for (const Key &key : keys)
+            set.remove(key);
+        timer.stop();
+        check_size(impl, "remove", 0, set.size());
+    }));
+
+    // Starts at 1/16th of the room it needs, so it grows about four times
+    report(impl, "resize", measure(reps, n, [&](Timer &timer) {
+        Set set(Sizing<Set>::capacity(n / 16));
+        timer.start();
+        for (const Key &key : keys)
+            set.add(key);
+        timer.stop();
+        check_size(impl, "resize", n, set.size());
+    }));
+
+    report(impl, "populate", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        timer.start();
+        set.populate(keys);
+        timer.stop();
+        check_size(impl, "populate", n, set.size());
+    }));
+
+    // What a monitor polling the set's size pays per poll
+    report(impl, "size", measure(reps, SIZE_POLLS, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        long total = 0;
+        timer.start();
+        for (int poll = 0; poll < SIZE_POLLS; poll++)
+            total += set.size();
+        timer.stop();
+        sink += total;
+        check_size(impl, "size", n, total / SIZE_POLLS);
+    }));
+}
+
+/**
+ * String keys only: lookups and removes through std::string_view, which the
+ * cuckoo sets hash and compare without building a std::string, and adds
+ * that hand over their key with std::move
+ */
+template <class Set>
+void run_string_suite(const char *impl, const std::vector<std::string> &keys, int reps) {
+    int n = keys.size();
+    int room = Sizing<Set>::capacity(2 * n);
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+
+    report(impl, "contains_view", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        long hits = 0;
+        timer.start();
+        for (std::string_view key : views)
+            hits += set.contains(key);
+        timer.stop();
+        sink += hits;
+        check_size(impl, "contains_view", n, hits);
+    }));
+
+    report(impl, "remove_view", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        timer.start();
+        for (std::string_view key : views)
+            set.remove(key);
+        timer.stop();
+        check_size(impl, "remove_view", 0, set.size());
+    }));
+
+    report(impl, "add_move", measure(reps, n, [&](Timer &timer) {
+        Set set(Sizing<Set>::capacity(4 * n));
+        std::vector<std::string> owned(keys);
+        timer.start();
+        for (std::string &key : owned)
+            set.add(std::move(key));
+        timer.stop();
+        check_size(impl, "add_move", n, set.size());
+    }));
+}
+
+/**
+ * Whole-set passes through the bulk operations against the equivalent loop
+ * of single-key calls, in ns per element. Half the keys are odd.
+ */
+template <class Set>
+void run_bulk_suite(const char *impl, const std::vector<int> &keys, int reps) {
+    int n = keys.size();
+    int room = Sizing<Set>::capacity(2 * n);
+    int odd = std::count_if(keys.begin(), keys.end(), [](int key) { return key & 1; });
+    std::vector<int> even;
+    std::copy_if(keys.begin(), keys.end(), std::back_inserter(even), [](int key) { return !(key & 1); });
+
+    report(impl, "for_each", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        std::atomic<long> visited(0);
+        timer.start();
+        set.for_each([&](const int &) { visited.fetch_add(1, std::memory_order_relaxed); });
+        timer.stop();
+        check_size(impl, "for_each", n, visited);
+    }));
+
+    report(impl, "for_each_loop", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        long visited = 0;
+        timer.start();
+        for (int key : keys)
+            visited += set.contains(key);
+        timer.stop();
+        check_size(impl, "for_each_loop", n, visited);
+    }));
+
+    report(impl, "erase_if", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        timer.start();
+        set.erase_if([](const int &key) { return key & 1; });
+        timer.stop();
+        check_size(impl, "erase_if", n - odd, set.size());
+    }));
+
+    report(impl, "erase_if_loop", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        timer.start();
+        for (int key : keys) {
+            if (key & 1)
+                set.remove(key);
+        }
+        timer.stop();
+        check_size(impl, "erase_if_loop", n - odd, set.size());
+    }));
+
+    report(impl, "intersect", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        Set other(room);
+        other.populate(even);
+        timer.start();
+        set.intersect(other);
+        timer.stop();
+        check_size(impl, "intersect", n - odd, set.size());
+    }));
+
+    report(impl, "intersect_loop", measure(reps, n, [&](Timer &timer) {
+        Set set(room);
+        set.populate(keys);
+        Set other(room);
+        other.populate(even);
+        timer.start();
+        for (int key : keys) {
+            if (!other.contains(key))
+                set.remove(key);
+        }
+        timer.stop();
+        check_size(impl, "intersect_loop", n - odd, set.size());
+    }));
+}
+
+/**
+ * Lookup latency and dTLB load misses of the serial set with its rows on
+ * regular pages, transparent huge pages and hugetlbfs pages. Rows are
+ * pre-faulted. The entries go through the same allocator, but at their size
+ * it hands them to operator new, so the misses counted on the way from a
+ * slot to its entry are not affected by the page size.
+ */
+void run_page_suite(int num_keys, int reps, std::mt19937 &generator) {
+    typedef CuckooSerialHashSet<int, false, TableAllocator<int>> Set;
+    auto all_keys = generate_keys(2 * num_keys, generator);
+    std::vector<int> keys(all_keys.begin(), all_keys.begin() + num_keys);
+    std::vector<int> absent(all_keys.begin() + num_keys, all_keys.end());
+    std::shuffle(keys.begin(), keys.end(), generator);
+
+    struct Mode {
+        const char *name;
+        PageMode pages;
+    };
+    const Mode modes[] = {{"4k", PageMode::Small}, {"thp", PageMode::Transparent}, {"hugetlb", PageMode::Huge}};
+    PerfCounter dtlb(PERF_TYPE_HW_CACHE, dtlb_load_misses_config());
+
+    std::cout << std::endl << num_keys << " keys, serial set rows by page size" << std::endl;
+    std::cout << std::left << std::setw(10) << "pages" << std::setw(16) << "bench" << std::right
+              << std::setw(12) << "median_ns" << std::setw(14) << "dtlb_miss/op" << "  backing" << std::endl;
+    for (const Mode &mode : modes) {
+        TableMemory memory;
+        memory.pages = mode.pages;
+        memory.prefault = true;
+        TableMemoryStats &stats = table_memory_stats();
+        long huge_before = stats.huge, transparent_before = stats.transparent;
+
+        for (int miss = 0; miss < 2; miss++) {
+            const std::vector<int> &lookups = miss ? absent : keys;
+            uint64_t misses = 0;
+            Stats timing = measure(reps, lookups.size(), [&](Timer &timer) {
+                Set set(num_keys, FullPolicy::Resize, TableAllocator<int>(memory));
+                set.populate(keys);
+                long hits = 0;
+                dtlb.start();
+                timer.start();
+                for (int key : lookups)
+                    hits += set.contains(key);
+                timer.stop();
+                dtlb.stop();
+                misses += dtlb.value();
+                sink += hits;
+                check_size("serial", miss ? "contains_miss" : "contains_hit", miss ? 0 : num_keys, hits);
+            });
+            std::cout << std::left << std::setw(10) << mode.name << std::setw(16)
+                      << (miss ? "contains_miss" : "contains_hit") << std::right << std::fixed
+                      << std::setprecision(2) << std::setw(12) << timing.median << std::setw(14);
+            if (dtlb.available())
+                std::cout << std::setprecision(4) << (double) misses / ((double) lookups.size() * (WARMUP_REPS + reps));
+            else
+                std::cout << "n/a";
+            const char *backing = stats.huge > huge_before ? "hugetlb"
+                                : stats.transparent > transparent_before ? "thp" : "4k";
+            std::cout << "  " << backing << std::endl;
+        }
+    }
+}
+
+/**
+ * What a second thread attaching to the adaptive set and detaching again
+ * costs, switching it to shared mode and back
+ */
+void run_mode_switch_suite(int reps) {
+    report("adaptive", "attach_detach", measure(reps, MODE_SWITCHES, [&](Timer &timer) {
+        CuckooAdaptiveHashSet<int> set(1);
+        set.attach();
+        timer.start();
+        for (int i = 0; i < MODE_SWITCHES; i++) {
+            set.attach();
+            set.detach();
+        }
+        timer.stop();
+        if (!set.solo())
+            std::cerr << "adaptive attach_detach: still in shared mode" << std::endl;
+    }));
+}
+
+/**
+ * Worst-case insert latency. Keys go one by one into a set sized for 1/16th
+ * of them, so it has to grow about four times. add() grows on the inserting
+ * thread; try_add() reports TableFull instead and the key is retried once
+ * the table has grown, by the inserting thread between calls or, with
+ * background_grow, by a second thread meanwhile. Every call is timed on its
+ * own, retries included.
+ */
+template <class Set>
+void run_tail_suite(const char *impl, const std::vector<int> &keys, bool background_grow) {
+    int n = keys.size();
+    std::vector<long> latencies;
+    latencies.reserve(2 * n);
+    auto timed = [&](auto &&call) {
+        auto start = std::chrono::steady_clock::now();
+        auto result = call();
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        return result;
+    };
+    auto report_tail = [&](const char *bench, long table_full) {
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))];
+        };
+        std::cout << std::left << std::setw(22) << impl << std::setw(18) << bench << std::right
+                  << std::setw(10) << latencies.size() << std::setw(10) << percentile(0.5)
+                  << std::setw(10) << percentile(0.99) << std::setw(10) << percentile(0.999)
+                  << std::setw(12) << latencies.back() << std::setw(12) << table_full << std::endl;
+    };
+
+    // add() does not change with background_grow
+    if (!background_grow) {
+        Set set(Sizing<Set>::capacity(n / 16));
+        for (int key : keys)
+            timed([&]() { return set.add(key); });
+        check_size(impl, "add", n, set.size());
+        report_tail("add", 0);
+        latencies.clear();
+    }
+
+    {
+        Set set(Sizing<Set>::capacity(n / 16));
+        // Raised by the inserting thread, cleared by the grower once grown
+        std::atomic<bool> full(false);
+        std::atomic<bool> done(false);
+        std::thread grower;
+        if (background_grow) {
+            grower = std::thread([&]() {
+                while (!done) {
+                    if (full) {
+                        set.grow();
+                        full = false;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        auto need_room = [&]() {
+            if (background_grow)
+                full = true;
+            else
+                set.grow();
+        };
+        long table_full = 0;
+        std::vector<int> pending;
+        for (int key : keys) {
+            if (timed([&]() { return set.try_add(key, TRY_ADD_BUDGET); }) == AddStatus::TableFull) {
+                table_full++;
+                pending.push_back(key);
+                need_room();
+            }
+        }
+        for (int key : pending) {
+            for (;;) {
+                while (full)
+                    std::this_thread::yield();
+                if (timed([&]() { return set.try_add(key, TRY_ADD_BUDGET); }) != AddStatus::TableFull)
+                    break;
+                table_full++;
+                need_room();
+            }
+        }
+        done = true;
+        if (grower.joinable())
+            grower.join();
+        check_size(impl, "try_add", n, set.size());
+        report_tail(background_grow ? "try_add+bg_grow" : "try_add", table_full);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int num_keys = DEFAULT_KEYS;
+    int reps = DEFAULT_REPS;
+    bool strings = true;
+    int page_keys = 0;
+    int tail_keys = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "k:r:cSt:l:")) != -1) {
+        switch (opt) {
+            case 'k': num_keys = atoi(optarg); break;
+            case 'r': reps = atoi(optarg); break;
+            case 'c': csv = true; break;
+            case 'S': strings = false; break;
+            case 't': page_keys = atoi(optarg); break;
+            case 'l': tail_keys = atoi(optarg); break;
+            default:
+                std::cerr << "Usage: " << argv[0] << " [-k keys] [-r repetitions] [-c (csv output)] [-S (skip string keys)]"
+                          << " [-t keys (page size comparison)] [-l keys (insert tail latency)]" << std::endl;
+                return 1;
+        }
+    }
+
+    std::mt19937 generator(KEY_SEED);
+    auto all_keys = generate_keys(2 * num_keys, generator);
+    std::vector<int> keys(all_keys.begin(), all_keys.begin() + num_keys);
+    std::vector<int> absent(all_keys.begin() + num_keys, all_keys.end());
+
+    if (csv) {
+        std::cout << "impl,bench,median_ns,min_ns,mean_ns,stddev_ns" << std::endl;
+    } else {
+        std::cout << num_keys << " keys, " << reps << " repetitions, ns/op" << std::endl;
+        std::cout << std::left << std::setw(22) << "impl" << std::setw(18) << "bench" << std::right
+                  << std::setw(12) << "median" << std::setw(12) << "min" << std::setw(12) << "mean"
+                  << std::setw(12) << "stddev" << std::setw(16) << "ops/sec" << std::endl;
+    }
+    run_suite<CuckooSerialHashSet<int>>("serial", keys, absent, reps);
+    // Single-thread overhead of the adaptive set over serial, solo and shared
+    run_suite<CuckooAdaptiveHashSet<int>>("adaptive", keys, absent, reps);
+    run_suite<SharedAdaptiveHashSet<int>>("adaptive/shared", keys, absent, reps);
+    run_mode_switch_suite(reps);
+    run_suite<CuckooConcurrentHashSet<int>>("concurrent", keys, absent, reps);
+    run_suite<CuckooTransactionalHashSet<int>>("transactional", keys, absent, reps);
+    run_suite<StdUnorderedSet<int>>("unordered_set", keys, absent, reps);
+    run_suite<LockedUnorderedSet<int>>("locked_unordered", keys, absent, reps);
+    run_bulk_suite<CuckooSerialHashSet<int>>("serial", keys, reps);
+    run_bulk_suite<CuckooConcurrentHashSet<int>>("concurrent", keys, reps);
+
+    if (page_keys > 0)
+        run_page_suite(page_keys, reps, generator);
+
+    if (tail_keys > 0) {
+        auto tail_keys_list = generate_keys(tail_keys, generator);
+        std::cout << std::endl << tail_keys << " keys, insert latency (ns) from 1/16th capacity, try_add budget "
+                  << TRY_ADD_BUDGET << std::endl;
+        std::cout << std::left << std::setw(22) << "impl" << std::setw(18) << "bench" << std::right
+                  << std::setw(10) << "calls" << std::setw(10) << "p50" << std::setw(10) << "p99"
+                  << std::setw(10) << "p99.9" << std::setw(12) << "max" << std::setw(12) << "table_full" << std::endl;
+        run_tail_suite<CuckooSerialHashSet<int>>("serial", tail_keys_list, false);
+        run_tail_suite<CuckooConcurrentHashSet<int>>("concurrent", tail_keys_list, false);
+        run_tail_suite<CuckooConcurrentHashSet<int>>("concurrent", tail_keys_list, true);
+    }
+
+    if (!strings)
+        return 0;
+    auto all_strings = generate_string_keys(2 * num_keys, generator);
+    std::vector<std::string> string_keys(all_strings.begin(), all_strings.begin() + num_keys);
+    std::vector<std::string> absent_strings(all_strings.begin() + num_keys, all_strings.end());
+    run_suite<CuckooSerialHashSet<std::string>>("serial/str", string_keys, absent_strings, reps);
+    run_suite<CuckooConcurrentHashSet<std::string>>("concurrent/str", string_keys, absent_strings, reps);
+    run_suite<CuckooTransactionalHashSet<std::string>>("transactional/str", string_keys, absent_strings, reps);
+    run_suite<CuckooSerialHashSet<std::string, true>>("serial/str+hash", string_keys, absent_strings, reps);
+    run_suite<CuckooConcurrentHashSet<std::string, true>>("concurrent/str+hash", string_keys, absent_strings, reps);
+    run_suite<StdUnorderedSet<std::string>>("unordered_set/str", string_keys, absent_strings, reps);
+    run_suite<LockedUnorderedSet<std::string>>("locked_unordered/str", string_keys, absent_strings, reps);
+    run_string_suite<CuckooSerialHashSet<std::string>>("serial/str", string_keys, reps);
+    run_string_suite<CuckooConcurrentHashSet<std::string>>("concurrent/str", string_keys, reps);
+    run_string_suite<CuckooTransactionalHashSet<std::string>>("transactional/str", string_keys, reps);
+    run_string_suite<CuckooSerialHashSet<std::string, true>>("serial/str+hash", string_keys, reps);
+    run_string_suite<CuckooConcurrentHashSet<std::string, true>>("concurrent/str+hash", string_keys, reps);
+    return 0;
+}
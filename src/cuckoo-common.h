@@ -0,0 +1,156 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+
+/**
+ * What an engine does when the displacement budget runs out on add
+ */
+enum class FullPolicy {
+    // Grow the table (the default)
+    Resize,
+    // Keep memory fixed and drop the entry left at the end of the cuckoo path
+    Evict,
+    // As Evict, but prefer entries whose access bit is clear (CLOCK)
+    EvictClock
+};
+
+/**
+ * Outcome of try_add
+ */
+enum class AddStatus {
+    Added,
+    // An equal value was already in the table
+    Present,
+    // No room within the displacement budget. The table is unchanged; grow()
+    // it and retry.
+    TableFull
+};
+
+/**
+ * Marks K as a lookup type for sets of T: contains() and remove() then take
+ * a K directly instead of building a T from it. K must hash like T under
+ * std::hash and compare with T using ==. Specialize for other pairs.
+ */
+template <class T, class K>
+struct is_heterogeneous_key : std::false_type {};
+
+template <class CharT, class Traits>
+struct is_heterogeneous_key<std::basic_string<CharT, Traits>, std::basic_string_view<CharT, Traits>>
+    : std::true_type {};
+
+template <class T, class K>
+using enable_if_heterogeneous_t = std::enable_if_t<is_heterogeneous_key<T, K>::value, int>;
+
+/**
+ * Base of an engine's entries holding the key's full std::hash when the
+ * engine caches it (CACHE_HASH), so displacement and resize never rehash the
+ * key and lookups reject most mismatches before comparing keys. Empty
+ * otherwise.
+ */
+template <bool CACHE_HASH>
+struct CachedHash {
+    CachedHash(size_t) {}
+    bool may_equal(size_t) const { return true; }
+};
+
+template <>
+struct CachedHash<true> {
+    size_t hash;
+    CachedHash(size_t hash) : hash(hash) {}
+    bool may_equal(size_t other) const { return hash == other; }
+};
+
+/**
+ * Element count split over cache-line padded counters, indexed by lock
+ * stripe, so writers holding different stripes rarely share a line. At most
+ * MAX_SLOTS counters are kept so that sum() stays cheap however many stripes
+ * there are. sum() can be called from anywhere and is exact once writers are
+ * quiescent.
+ */
+class StripedCounter {
+    static constexpr size_t MAX_SLOTS = 64;
+
+    struct alignas(64) Slot {
+        std::atomic<long> value{0};
+    };
+
+    std::vector<Slot> slots;
+
+    public:
+        StripedCounter(size_t stripes) : slots(std::max<size_t>(1, std::min(stripes, MAX_SLOTS))) {}
+
+        void add(size_t stripe, long delta) {
+            slots[stripe % slots.size()].value.fetch_add(delta, std::memory_order_relaxed);
+        }
+
+        /**
+         * return: the count of stripe's counter, which it may share with
+         * other stripes
+         */
+        long get(size_t stripe) const {
+            return slots[stripe % slots.size()].value.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * return: the number of stripes sharing each counter
+         */
+        size_t slot_count() const {
+            return slots.size();
+        }
+
+        long sum() const {
+            long total = 0;
+            for (auto &slot : slots)
+                total += slot.value.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        /**
+         * Caller ensures no writer runs meanwhile
+         */
+        void reset() {
+            for (auto &slot : slots)
+                slot.value.store(0, std::memory_order_relaxed);
+        }
+};
+
+/**
+ * return: the worker count bulk operations use by default, one per core
+ */
+inline int default_workers() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Slots a bulk operation must cover per thread before starting another
+// pays for the tens of microseconds a thread takes to start and join
+const long SCAN_MIN_PER_THREAD = 1 << 16;
+
+/**
+ * Runs work(chunk) for every chunk in [0, chunks) on up to workers threads,
+ * the calling thread being one of them. Threads take the next chunk as they
+ * free up, so uneven chunks still balance. slots is the work's total size:
+ * only one thread is used per SCAN_MIN_PER_THREAD of it, so small tables
+ * are scanned on the calling thread alone.
+ */
+template <class Work>
+void run_chunks(int chunks, int workers, long slots, const Work &work) {
+    std::atomic<int> next(0);
+    auto drain = [&]() {
+        for (int chunk; (chunk = next.fetch_add(1, std::memory_order_relaxed)) < chunks;)
+            work(chunk);
+    };
+    workers = std::min<long>(workers, std::max(1L, slots / SCAN_MIN_PER_THREAD));
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min(workers, chunks); i++)
+        threads.emplace_back(drain);
+    drain();
+    for (auto &thread : threads)
+        thread.join();
+}
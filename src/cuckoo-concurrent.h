@@ -1,3 +1,5 @@
+#pragma once
+
 #include <vector>
 #include <stdlib.h>
 #include <iostream>
@@ -5,16 +7,54 @@
 #include <ctime>
 #include <list>
 #include <mutex>
+#include <atomic>
+#include <optional>
+#include <algorithm>
+#include <memory>
+#include <assert.h>
+
+#include "cuckoo-common.h"
 
-template <class T>
+/**
+ * CACHE_HASH: store each key's std::hash next to it, see CachedHash. Pays
+ * off for keys that are expensive to hash or compare, such as long strings.
+ * Alloc: allocates the rows of probe sets and the list nodes of entries,
+ * e.g. TableAllocator for huge pages. TableAllocator hands node-sized
+ * requests to operator new, so only the rows move to huge pages.
+ */
+template <class T, bool CACHE_HASH = false, class Alloc = std::allocator<T>>
 class CuckooConcurrentHashSet {
+    struct Entry : CachedHash<CACHE_HASH> {
+        T val;
+        // CLOCK access bit, only maintained under FullPolicy::EvictClock
+        bool referenced;
+        Entry(const T &val, size_t hash) : CachedHash<CACHE_HASH>(hash), val(val), referenced(false) {}
+        Entry(T &&val, size_t hash) : CachedHash<CACHE_HASH>(hash), val(std::move(val)), referenced(false) {}
+    };
+
     const int PROBE_SIZE = 8;
     const int THRESHOLD = PROBE_SIZE/2;
-    int limit;
-    size_t salt0;
-    size_t salt1;
-    int capacity;
-    std::vector<std::vector<std::list<T>>> table;
+    // Relocation budget when the table cannot grow
+    const int EVICT_LIMIT = 32;
+    // Probe sets per row a chunk of a bulk operation covers, at least one
+    // stripe's worth
+    const int SCAN_CHUNK = 4096;
+    // Changed by resize() under every table0 stripe, read anywhere
+    std::atomic<int> limit;
+    std::atomic<size_t> salt0;
+    std::atomic<size_t> salt1;
+    std::atomic<int> capacity;
+    FullPolicy policy;
+    std::atomic<long> evicted;
+    // Entries counted by table0 lock stripe
+    StripedCounter counts;
+    // Grow once this share of the slots is in use, see max_load_factor()
+    double max_load = 1.0;
+    using List = std::list<Entry, typename std::allocator_traits<Alloc>::template rebind_alloc<Entry>>;
+    using RowAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<List>;
+    using Row = std::vector<List, RowAlloc>;
+    RowAlloc alloc;
+    std::vector<Row> table;
     // Note: locks cannot be resized
     std::vector<std::vector<std::recursive_mutex*>> locks;
 
@@ -25,74 +65,134 @@ class CuckooConcurrentHashSet {
         seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
     }
 
-    int hash0(const T val) {
+    template <class K>
+    size_t key_hash(const K &val) {
+        return std::hash<K>()(val);
+    }
+
+    /**
+     * return: the std::hash of entry's key, rehashing it only when not cached
+     */
+    size_t entry_hash(const Entry &entry) {
+        if constexpr (CACHE_HASH)
+            return entry.hash;
+        else
+            return key_hash(entry.val);
+    }
+
+    // Full hashes derive from a key's std::hash and the salts, so a new salt
+    // never needs the key itself
+    int hash0(size_t hash) {
         size_t seed = 0;
-        hash_combine(seed, val);
-        hash_combine(seed, salt0);
+        hash_combine(seed, hash);
+        hash_combine(seed, salt0.load(std::memory_order_relaxed));
         return abs((int) seed);
     }
 
-    int hash1(const T val) {
+    int hash1(size_t hash) {
         size_t seed = 0;
-        hash_combine(seed, val);
-        hash_combine(seed, salt1);
+        hash_combine(seed, hash);
+        hash_combine(seed, salt1.load(std::memory_order_relaxed));
         return abs((int) seed);
     }
 
-    bool relocate(int i, int hi) {
-        int hj = 0;
+    int full_hash(int i, const Entry &entry) {
+        return i == 0 ? hash0(entry_hash(entry)) : hash1(entry_hash(entry));
+    }
+
+    /**
+     * Moves entries out of the overfull probe set table[i][hi] until some
+     * probe set on the path is back under THRESHOLD, for at most rounds
+     * moves. Entries move as list nodes, their keys are never copied.
+     * return: true if successful
+     */
+    bool relocate(int i, int hi, int rounds) {
         int j = 1 - i;
-        for (int round = 0; round < limit; round++) {
-            T val = table[i][hi].front();
-            switch (i) {
-                case 0: hj = hash1(val) % capacity; break;
-                case 1: hj = hash0(val) % capacity; break;
+        for (int round = 0; round < rounds; round++) {
+            // Hash the oldest entry under its own stripe, the list may be
+            // changing underneath. A table0 stripe is always taken first, it
+            // also keeps a resize from replacing the table meanwhile.
+            int full[2];
+            {
+                std::lock_guard<std::recursive_mutex> guard0(*locks[0][hi % locks[0].size()]);
+                std::lock_guard<std::recursive_mutex> guard1(*locks[1][hi % locks[1].size()]);
+                if (table[i][hi].empty())
+                    return true;
+                size_t hash = entry_hash(table[i][hi].front());
+                full[0] = hash0(hash);
+                full[1] = hash1(hash);
             }
-            acquire(val);
-            auto it = std::find(table[i][hi].begin(), table[i][hi].end(), val);
-            if (it != table[i][hi].end()) {
-                table[i][hi].erase(it);
-                if (table[j][hj].size() < THRESHOLD) {
-                    table[j][hj].push_back(val);
-                    release(val);
+            // A resize in between changes the salts, the check below then
+            // fails for whatever entry the probe set holds now
+            acquire(full[0], full[1]);
+            int hj = full[j] % capacity;
+            List &iSet = table[i][hi];
+            List &jSet = table[j][hj];
+            // Whatever entry is at the front now can move if it shares the
+            // pair of probe sets, since those are the ones locked
+            if (!iSet.empty() && full_hash(j, iSet.front()) == full[j]) {
+                if (jSet.size() < THRESHOLD) {
+                    jSet.splice(jSet.end(), iSet, iSet.begin());
+                    release(full[0], full[1]);
                     return true;
-                } else if (table[j][hj].size() < PROBE_SIZE) {
-                    table[j][hj].push_back(val);
+                } else if (jSet.size() < PROBE_SIZE) {
+                    jSet.splice(jSet.end(), iSet, iSet.begin());
                     i = 1 - i;
                     hi = hj;
                     j = 1 - j;
-                    release(val);
+                    release(full[0], full[1]);
                 } else {
-                    table[i][hi].push_back(val);
-                    release(val);
+                    iSet.splice(iSet.end(), iSet, iSet.begin());
+                    release(full[0], full[1]);
                     return false;
                 }
-            } else if (table[i][hi].size() >= THRESHOLD) {
-                release(val);
+            } else if (iSet.size() >= THRESHOLD) {
+                release(full[0], full[1]);
                 continue;
             } else {
-                release(val);
+                release(full[0], full[1]);
                 return true;
             }
         }
         return false;
     }
 
-    void acquire(const T val) {
-        locks[0][hash0(val) % locks[0].size()]->lock();
-        locks[1][hash1(val) % locks[1].size()]->lock();
+    /**
+     * Locks the stripes covering full hashes hash0 and hash1. The full
+     * hashes depend on the salts, which a resize changes, so locking a key
+     * goes through acquire_key.
+     */
+    void acquire(int hash0, int hash1) {
+        locks[0][hash0 % locks[0].size()]->lock();
+        locks[1][hash1 % locks[1].size()]->lock();
     }
 
-    void release(const T val) {
-        locks[0][hash0(val) % locks[0].size()]->unlock();
-        locks[1][hash1(val) % locks[1].size()]->unlock();
+    /**
+     * Computes the full hashes of the key with std::hash hash and locks
+     * their stripes. A resize holds every table0 stripe while it changes
+     * the salts, so the hashes are checked again under the locks and taken
+     * anew if a resize ran in between.
+     */
+    void acquire_key(size_t hash, int &full0, int &full1) {
+        while (true) {
+            full0 = hash0(hash);
+            full1 = hash1(hash);
+            acquire(full0, full1);
+            if (hash0(hash) == full0 && hash1(hash) == full1)
+                return;
+            release(full0, full1);
+        }
+    }
+
+    void release(int hash0, int hash1) {
+        locks[0][hash0 % locks[0].size()]->unlock();
+        locks[1][hash1 % locks[1].size()]->unlock();
     }
 
     /**
      * Resizes the table to be twice as big. Changes salt0 and salt1.
      */
     void resize() {
-        //std::cout << "resize" << std::endl;
         int oldCapacity = capacity;
         // Since we have consistent ordering when acquiring locks, we only need
         // to acquire the locks for table0.
@@ -101,32 +201,38 @@ class CuckooConcurrentHashSet {
         }
 
         // Another resize happened
-        if (capacity != oldCapacity)
+        if (capacity != oldCapacity) {
+            for (auto lock : locks[0])
+                lock->unlock();
             return;
+        }
         
         // Get new salt values to change the hashes
-        hash_combine(salt0, time(NULL));
-        hash_combine(salt1, time(NULL));
+        size_t new_salt0 = salt0;
+        size_t new_salt1 = salt1;
+        hash_combine(new_salt0, time(NULL));
+        hash_combine(new_salt1, time(NULL));
+        salt0 = new_salt0;
+        salt1 = new_salt1;
 
-        capacity *= 2;
-        limit *= 2;
-        std::vector<std::vector<std::list<T>>> old_table(table);
+        capacity = 2 * capacity;
+        limit = 2 * limit;
+        std::vector<Row> old_table(std::move(table));
         table.clear();
-        for (int i = 0; i < 2; i++) {
-            std::vector<std::list<T>> row;
-            for (int j = 0; j < capacity; j++) {
-                std::list<T> probe_set;
-                row.push_back(probe_set);
-            }
-            table.push_back(row);
-        }
+        counts.reset();
+        for (int i = 0; i < 2; i++)
+            table.emplace_back(capacity, List(alloc), alloc);
 
-        // Add the elements back into the bigger table
-        for (auto row : old_table) {
-            for (auto probe_set : row) {
-                for (auto entry : probe_set) {
-                    add(entry); //TODO: what if this add call calls resize again? segfault
-                    // Problem: add releases locks...
+        // Add the elements back into the bigger table. They are placed as
+        // under FullPolicy::Resize whatever the policy, so none is evicted;
+        // if one does not fit, the table grows again from in here, which
+        // the recursive stripe locks already held allow.
+        for (auto &row : old_table) {
+            for (auto &probe_set : row) {
+                for (auto &entry : probe_set) {
+                    std::optional<T> victim;
+                    insert(std::move(entry.val), entry_hash(entry), victim, FullPolicy::Resize);
+                    assert(!victim);
                 }
             }
         }
@@ -136,44 +242,299 @@ class CuckooConcurrentHashSet {
             lock->unlock();
     }
 
+    template <class K>
+    static typename List::iterator find(List &probe_set, const K &val, size_t hash) {
+        return std::find_if(probe_set.begin(), probe_set.end(), [&](const Entry &entry) {
+            return entry.may_equal(hash) && entry.val == val;
+        });
+    }
+
     /** 
-     * Checks if the table contains val
+     * Checks if probe sets table[0][h0] or table[1][h1] contain val.
+     * Caller holds their locks.
      * return: true if the table contains val
      */
-    bool present(const T val) {
-        std::list<T> set0 = table[0][hash0(val) % capacity];
-        if (std::find(set0.begin(), set0.end(), val) != set0.end()) {
+    template <class K>
+    bool present(int h0, int h1, const K &val, size_t hash) {
+        return find(table[0][h0], val, hash) != table[0][h0].end() || find(table[1][h1], val, hash) != table[1][h1].end();
+    }
+
+    /**
+     * Drops one entry from a full probe set so val can take its place. Under
+     * EvictClock the first entry with a clear access bit is taken, and the
+     * bits of entries passed over are cleared; otherwise the oldest entry.
+     * Caller holds val's locks, which cover both probe sets.
+     * return: the dropped value
+     */
+    T evict(List &probe_set) {
+        auto victim = probe_set.begin();
+        if (policy == FullPolicy::EvictClock) {
+            for (auto it = probe_set.begin(); it != probe_set.end(); ++it) {
+                if (!it->referenced) {
+                    victim = it;
+                    break;
+                }
+                it->referenced = false;
+            }
+        }
+        T val = std::move(victim->val);
+        probe_set.erase(victim);
+        evicted++;
+        return val;
+    }
+
+    /**
+     * Adds val, copied or moved in as U is an lvalue or rvalue. on_full is
+     * the policy applied when both probe sets are full, the set's own
+     * except while resize() re-adds entries.
+     * return: true if add was successful
+     */
+    template <class U>
+    bool insert(U &&val, size_t hash, std::optional<T> &victim, FullPolicy on_full) {
+        int full0, full1;
+        acquire_key(hash, full0, full1);
+        int h0 = full0 % capacity;
+        int h1 = full1 % capacity;
+        size_t stripe = full0 % locks[0].size();
+        int i = -1; 
+        int h = -1;
+        bool mustResize = false;
+        if (present(h0, h1, val, hash)) {
+            release(full0, full1);
+            return false;
+        }
+        if (table[0][h0].size() < THRESHOLD) {
+            table[0][h0].emplace_back(std::forward<U>(val), hash);
+            counts.add(stripe, 1);
+            release(full0, full1);
+            return true;
+        } else if (table[1][h1].size() < THRESHOLD) {
+            table[1][h1].emplace_back(std::forward<U>(val), hash);
+            counts.add(stripe, 1);
+            release(full0, full1);
+            return true;
+        } else if (table[0][h0].size() < PROBE_SIZE) {
+            table[0][h0].emplace_back(std::forward<U>(val), hash);
+            counts.add(stripe, 1);
+            i = 0;
+            h = h0;
+        } else if (table[1][h1].size() < PROBE_SIZE) {
+            table[1][h1].emplace_back(std::forward<U>(val), hash);
+            counts.add(stripe, 1);
+            i = 1;
+            h = h1;
+        } else if (on_full != FullPolicy::Resize) {
+            // The victim shares val's probe set and so its stripe, the
+            // count does not change
+            victim = evict(table[0][h0]);
+            table[0][h0].emplace_back(std::forward<U>(val), hash);
+            release(full0, full1);
+            return true;
+        } else {
+            mustResize = true;
+        }
+        release(full0, full1);
+
+        if (mustResize) {
+            // val was not consumed on this path
+            resize();
+            return insert(std::forward<U>(val), hash, victim, on_full);
+        } else if (!relocate(i, h, limit) && on_full == FullPolicy::Resize) {
+            // Under an evicting policy the entry simply stays in the
+            // overflow part of its probe set
+            resize();
+        }
+        return true;
+    }
+
+    /**
+     * As insert, but never resizes or evicts: with both probe sets full the
+     * table is left as it was. An entry that lands in the overflow part of
+     * a probe set stays there if relocation runs out of budget.
+     */
+    template <class U>
+    AddStatus try_insert(U &&val, size_t hash, int max_displacements) {
+        int full0, full1;
+        acquire_key(hash, full0, full1);
+        int h0 = full0 % capacity;
+        int h1 = full1 % capacity;
+        size_t stripe = full0 % locks[0].size();
+        int i;
+        if (present(h0, h1, val, hash)) {
+            release(full0, full1);
+            return AddStatus::Present;
+        }
+        if (table[0][h0].size() < THRESHOLD || table[1][h1].size() < THRESHOLD) {
+            i = table[0][h0].size() < THRESHOLD ? 0 : 1;
+        } else if (table[0][h0].size() < PROBE_SIZE) {
+            i = 0;
+        } else if (table[1][h1].size() < PROBE_SIZE) {
+            i = 1;
+        } else {
+            release(full0, full1);
+            return AddStatus::TableFull;
+        }
+        int h = i == 0 ? h0 : h1;
+        bool overflow = table[i][h].size() >= THRESHOLD;
+        table[i][h].emplace_back(std::forward<U>(val), hash);
+        counts.add(stripe, 1);
+        release(full0, full1);
+        if (overflow)
+            relocate(i, h, max_displacements);
+        return AddStatus::Added;
+    }
+
+    /**
+     * Adds val and grows the table early if that pushed the load factor past
+     * max_load_factor. Only the counter val went to is read on the fast
+     * path, scaled up to estimate the whole table, before paying for the
+     * exact sum.
+     * return: true if add was successful
+     */
+    template <class U>
+    bool add_and_grow(U &&val, size_t hash, std::optional<T> &victim) {
+        if (!insert(std::forward<U>(val), hash, victim, policy))
+            return false;
+        if (policy == FullPolicy::Resize && max_load < 1.0) {
+            size_t counters = counts.slot_count();
+            if (counts.get(hash0(hash) % locks[0].size()) * (double) counters > max_load * slots() && load_factor() > max_load)
+                resize();
+        }
+        return true;
+    }
+
+    double slots() {
+        return 2.0 * capacity * PROBE_SIZE;
+    }
+
+    /**
+     * Calls visit(val) for every value, with the lock stripes split into
+     * chunks over workers threads. A chunk locks its stripes of both tables
+     * once, table0 first as everywhere else, and covers every probe set
+     * they guard: stripe s guards sets s, s + stripes, ... of each row, since
+     * capacity stays a multiple of the stripe count. The entries visit
+     * returns true for are removed.
+     * return: the number of entries removed
+     */
+    template <class Visit>
+    long scan(int workers, const Visit &visit) {
+        int stripes = locks[0].size();
+        int per_chunk = std::max(1, SCAN_CHUNK / std::max(1, capacity / stripes));
+        int chunks = (stripes + per_chunk - 1) / per_chunk;
+        std::atomic<long> removed(0);
+        run_chunks(chunks, workers, 2L * capacity, [&](int chunk) {
+            int first = chunk * per_chunk;
+            int last = std::min(stripes, first + per_chunk);
+            for (int i = 0; i < 2; i++) {
+                for (int stripe = first; stripe < last; stripe++)
+                    locks[i][stripe]->lock();
+            }
+            // Holding table0 stripes keeps resize out, capacity is stable
+            long chunk_removed = 0;
+            for (int i = 0; i < 2; i++) {
+                for (int base = 0; base < capacity; base += stripes) {
+                    for (int stripe = first; stripe < last; stripe++) {
+                        List &probe_set = table[i][base + stripe];
+                        for (auto it = probe_set.begin(); it != probe_set.end();) {
+                            if (!visit(static_cast<const T&>(it->val))) {
+                                ++it;
+                                continue;
+                            }
+                            counts.add(i == 0 ? stripe : hash0(entry_hash(*it)) % stripes, -1);
+                            it = probe_set.erase(it);
+                            chunk_removed++;
+                        }
+                    }
+                }
+            }
+            for (int i = 0; i < 2; i++) {
+                for (int stripe = first; stripe < last; stripe++)
+                    locks[i][stripe]->unlock();
+            }
+            removed.fetch_add(chunk_removed, std::memory_order_relaxed);
+        });
+        return removed;
+    }
+
+    template <class K>
+    bool remove_key(const K &val) {
+        size_t hash = key_hash(val);
+        int full0, full1;
+        acquire_key(hash, full0, full1);
+        List &set0 = table[0][full0 % capacity];
+        auto it0 = find(set0, val, hash);
+        if (it0 != set0.end()) {
+            set0.erase(it0);
+            counts.add(full0 % locks[0].size(), -1);
+            release(full0, full1);
+            return true;
+        } else {
+            List &set1 = table[1][full1 % capacity];
+            auto it1 = find(set1, val, hash);
+            if (it1 != set1.end()) {
+                set1.erase(it1);
+                counts.add(full0 % locks[0].size(), -1);
+                release(full0, full1);
+                return true;
+            }
+        }
+        release(full0, full1);
+        return false;
+    }
+
+    template <class K>
+    bool contains_key(const K &val) {
+        size_t hash = key_hash(val);
+        int full0, full1;
+        acquire_key(hash, full0, full1);
+        List &set0 = table[0][full0 % capacity];
+        auto it0 = find(set0, val, hash);
+        if (it0 != set0.end()) {
+            if (policy == FullPolicy::EvictClock)
+                it0->referenced = true;
+            release(full0, full1);
             return true;
         } else {
-            std::list<T> set1 = table[1][hash1(val) % capacity];
-            if (std::find(set1.begin(), set1.end(), val) != set1.end()) {
+            List &set1 = table[1][full1 % capacity];
+            auto it1 = find(set1, val, hash);
+            if (it1 != set1.end()) {
+                if (policy == FullPolicy::EvictClock)
+                    it1->referenced = true;
+                release(full0, full1);
                 return true;
             }
         }
+        release(full0, full1);
         return false;
     }
 
     public:
-        CuckooConcurrentHashSet(int capacity) : capacity(capacity), limit(capacity/2) {
+        /**
+         * policy: whether a full table grows or evicts. When evicting, memory
+         * stays at capacity and relocation makes at most EVICT_LIMIT rounds.
+         * alloc: allocator for the rows of probe sets and the list nodes
+         */
+        CuckooConcurrentHashSet(int capacity, FullPolicy policy = FullPolicy::Resize, const Alloc &alloc = Alloc())
+            : capacity(capacity), limit(capacity/2), policy(policy), evicted(0), counts(capacity), alloc(alloc) {
+            if (policy != FullPolicy::Resize)
+                limit = std::min<int>(limit, EVICT_LIMIT);
             for (int i = 0; i < 2; i++) {
-                std::vector<std::list<T>> row;
                 std::vector<std::recursive_mutex*> locks_row;
                 for (int j = 0; j < capacity; j++) {
-                    std::list<T> probe_set;
-                    row.push_back(probe_set);
                     locks_row.emplace_back(new std::recursive_mutex());
                 }
-                table.emplace_back(row);
+                table.emplace_back(capacity, List(this->alloc), this->alloc);
                 locks.emplace_back(locks_row);
             }
-            salt0 = time(NULL);
-            salt1 = salt0;
-            hash_combine(salt1, capacity);
+            size_t seed = time(NULL);
+            salt0 = seed;
+            hash_combine(seed, capacity);
+            salt1 = seed;
         }
 
         ~CuckooConcurrentHashSet() {
-            for (auto row : table) {
-                for (auto probe_set : row) {
+            for (auto &row : table) {
+                for (auto &probe_set : row) {
                     probe_set.clear();
                 }
                 row.clear();
@@ -185,105 +546,211 @@ class CuckooConcurrentHashSet {
          * Adds val
          * return: true if add was successful
          */
-        bool add(const T val) {
-            acquire(val);
-            int h0 = hash0(val) % capacity;
-            int h1 = hash1(val) % capacity;
-            int i = -1; 
-            int h = -1;
-            bool mustResize = false;
-            if (present(val)) {
-                release(val);
+        bool add(const T &val) {
+            std::optional<T> victim;
+            return add_and_grow(val, key_hash(val), victim);
+        }
+
+        bool add(T &&val) {
+            std::optional<T> victim;
+            size_t hash = key_hash(val);
+            return add_and_grow(std::move(val), hash, victim);
+        }
+
+        /** 
+         * Adds val. If both probe sets are full and the table does not
+         * resize, an entry is dropped to make room and stored in victim.
+         * return: true if add was successful
+         */
+        bool add(const T &val, std::optional<T> &victim) {
+            return add_and_grow(val, key_hash(val), victim);
+        }
+
+        bool add(T &&val, std::optional<T> &victim) {
+            size_t hash = key_hash(val);
+            return add_and_grow(std::move(val), hash, victim);
+        }
+
+        /**
+         * Adds val with bounded work: relocation moves at most
+         * max_displacements entries, and the table never resizes or evicts
+         * on this thread. The load factor limit is not checked either; a
+         * background thread can watch load_factor() and grow().
+         * The latency bound does not hold while a resize runs, whether
+         * from grow() or another thread's add: try_add blocks on the stripe
+         * locks the resize holds until it finishes.
+         * return: Added, Present, or TableFull with the table unchanged
+         */
+        AddStatus try_add(const T &val, int max_displacements) {
+            return try_insert(val, key_hash(val), max_displacements);
+        }
+
+        AddStatus try_add(T &&val, int max_displacements) {
+            size_t hash = key_hash(val);
+            return try_insert(std::move(val), hash, max_displacements);
+        }
+
+        /**
+         * Doubles the capacity, e.g. after try_add reported TableFull. Safe
+         * to call while other threads add and remove.
+         */
+        void grow() {
+            resize();
+        }
+
+        /**
+         * Calls fn(val) for every value, holding the locks of val's stripe.
+         * The stripes are split over workers threads, so fn must be safe to
+         * call from several at once, and must not call into this set.
+         * Safe to call while other threads add and remove, but values they
+         * add or remove meanwhile, or move by a resize between chunks, can
+         * be missed or seen twice.
+         */
+        template <class Fn>
+        void for_each(const Fn &fn, int workers = default_workers()) {
+            scan(workers, [&](const T &val) {
+                fn(val);
                 return false;
-            }
-            if (table[0][h0].size() < THRESHOLD) {
-                table[0][h0].push_back(val);
-                release(val);
-                return true;
-            } else if (table[1][h1].size() < THRESHOLD) {
-                table[1][h1].push_back(val);
-                release(val);
-                return true;
-            } else if (table[0][h0].size() < PROBE_SIZE) {
-                table[0][h0].push_back(val);
-                i = 0;
-                h = h0;
-            } else if (table[1][h1].size() < PROBE_SIZE) {
-                table[1][h1].push_back(val);
-                i = 1;
-                h = h1;
-            } else {
-                mustResize = true;
-            }
-            release(val);
+            });
+        }
 
-            if (mustResize) {
-                resize();
-                add(val);
-            } else if (!relocate(i, h)) {
-                resize();
-            }
-            return true;
+        /**
+         * Removes every value pred(val) holds for. Runs as for_each, with the
+         * same rules for pred.
+         * return: the number of values removed
+         */
+        template <class Pred>
+        long erase_if(const Pred &pred, int workers = default_workers()) {
+            return scan(workers, pred);
+        }
+
+        /**
+         * Adds every value of other, which can be any set with for_each. The
+         * adds run on other's workers, inside other's for_each, so other
+         * must not be merging into this set at the same time.
+         * return: the number of values added
+         */
+        template <class Set>
+        long merge(Set &other, int workers = default_workers()) {
+            if ((void*) &other == (void*) this)
+                return 0;
+            std::atomic<long> added(0);
+            other.for_each([&](const T &val) {
+                if (add(val))
+                    added.fetch_add(1, std::memory_order_relaxed);
+            }, workers);
+            return added;
+        }
+
+        /**
+         * Removes every value other does not contain. other is probed under
+         * this set's stripe locks, so it must not be running a bulk
+         * operation against this set at the same time.
+         * return: the number of values removed
+         */
+        template <class Set>
+        long intersect(Set &other, int workers = default_workers()) {
+            if ((void*) &other == (void*) this)
+                return 0;
+            return erase_if([&](const T &val) { return !other.contains(val); }, workers);
+        }
+
+        /**
+         * Removes every value other contains, under the same rules as
+         * intersect
+         * return: the number of values removed
+         */
+        template <class Set>
+        long difference(Set &other, int workers = default_workers()) {
+            if ((void*) &other == (void*) this)
+                return erase_if([](const T&) { return true; }, workers);
+            return erase_if([&](const T &val) { return other.contains(val); }, workers);
+        }
+
+        /**
+         * Builds a value from args and adds it by move. The value is
+         * hashed and compared before it has a slot, so it is not
+         * constructed in place.
+         * return: true if add was successful
+         */
+        template <class... Args>
+        bool emplace(Args&&... args) {
+            return add(T(std::forward<Args>(args)...));
         }
 
         /** 
          * Removes val
          * return: true if remove was successful
          */
-        bool remove(const T val) {
-            acquire(val);
-            int h0 = hash0(val) % capacity;
-            auto it0 = std::find(table[0][h0].begin(), table[0][h0].end(), val);
-            if (it0 != table[0][h0].end()) {
-                table[0][h0].erase(it0);
-                release(val);
-                return true;
-            } else {
-                int h1 = hash1(val) % capacity;
-                auto it1 = std::find(table[1][h1].begin(), table[1][h1].end(), val);
-                if (it1 != table[1][h1].end()) {
-                    table[1][h1].erase(it1);
-                    release(val);
-                    return true;
-                }
-            }
-            release(val);
-            return false;
+        bool remove(const T &val) {
+            return remove_key(val);
+        }
+
+        /**
+         * Removes the value equal to key, see is_heterogeneous_key
+         * return: true if remove was successful
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool remove(const K &key) {
+            return remove_key(key);
         }
 
         /** 
          * Checks if the table contains val
          * return: true if the table contains val
          */
-        bool contains(const T val) {
-            acquire(val);
-            std::list<T> set0 = table[0][hash0(val) % capacity];
-            if (std::find(set0.begin(), set0.end(), val) != set0.cend()) {
-                release(val);
-                return true;
-            } else {
-                std::list<T> set1 = table[1][hash1(val) % capacity];
-                if (std::find(set1.begin(), set1.end(), val) != set1.cend()) {
-                    release(val);
-                    return true;
-                }
-            }
-            release(val);
-            return false;
+        bool contains(const T &val) {
+            return contains_key(val);
         }
 
         /**
-         * Counts the number of elements in the table
+         * Checks if the table contains a value equal to key, see
+         * is_heterogeneous_key
+         * return: true if the table contains it
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool contains(const K &key) {
+            return contains_key(key);
+        }
+
+        /**
+         * return: The number of entries dropped to make room so far
+         */
+        long evictions() {
+            return evicted;
+        }
+
+        /**
+         * Safe to call while other threads add and remove; the result may
+         * then miss operations in flight. Exact once they have finished.
          * return: The number of elements in the table
          */
         int size() {
-            int size = 0;
-            for (auto row : table) {
-                for (auto probe_set : row) {
-                    size += probe_set.size();
-                }
-            }
-            return size;
+            return counts.sum();
+        }
+
+        /**
+         * As size(), safe to call concurrently
+         * return: The share of the table's slots (PROBE_SIZE per probe set)
+         * in use
+         */
+        double load_factor() {
+            return counts.sum() / slots();
+        }
+
+        double max_load_factor() {
+            return max_load;
+        }
+
+        /**
+         * Makes add grow the table as soon as the load factor passes
+         * max_load_factor, instead of only once relocation fails. Probe sets
+         * start to overflow at THRESHOLD, a load factor of 0.5. The default
+         * of 1.0 never triggers.
+         * Thread non-safe!
+         */
+        void max_load_factor(double max_load_factor) {
+            max_load = max_load_factor;
         }
 
         /**
@@ -291,8 +758,8 @@ class CuckooConcurrentHashSet {
          * Thread non-safe!
          * return: true if successful
          */
-        bool populate(const std::vector<T> entries) {
-            for (T entry : entries) {
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
                 if (!add(entry)) {
                     std::cout << "Duplicate entry attempted for populate!" << std::endl;
                     return false;
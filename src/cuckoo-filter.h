@@ -0,0 +1,381 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <iostream>
+#include <functional>
+#include <ctime>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <memory>
+
+#include "cuckoo-common.h"
+
+/**
+ * Approximate membership filter built on the same two-bucket displacement and
+ * lock striping as CuckooConcurrentHashSet. Only a small fingerprint of each
+ * key is kept, and the alternate bucket is derived from the fingerprint alone
+ * (partial-key cuckoo hashing), so entries can be relocated and deleted
+ * without the original key.
+ *
+ * contains() never returns a false negative for a key that was added and not
+ * removed. It returns a false positive with probability about
+ * 2 * SLOTS_PER_BUCKET / 2^fingerprint_bits. Only remove keys that were added,
+ * otherwise a colliding fingerprint of another key may be removed instead.
+ * The filter cannot resize (the keys are gone), so add() fails once full.
+ */
+template <class T, class Alloc = std::allocator<uint64_t>>
+class CuckooFilter {
+    static const int SLOTS_PER_BUCKET = 4;
+    static const int MAX_KICKS = 500;
+    static const int MAX_ATTEMPTS = 8;
+    // Buckets guarded by one lock. Each stripe is SLOTS_PER_BUCKET * 64 *
+    // fingerprint_bits bits long, a whole number of words, so two stripes
+    // never share a word of the packed table.
+    static const int BUCKETS_PER_STRIPE = 64;
+    static const int MAX_STRIPES = 4096;
+
+    struct Step {
+        size_t bucket;
+        int slot;
+        uint32_t fingerprint;
+    };
+
+    int fingerprint_bits;
+    uint32_t fingerprint_mask;
+    size_t num_buckets;
+    size_t salt;
+    // Fingerprints packed back to back, SLOTS_PER_BUCKET per bucket. 0 marks an
+    // empty slot.
+    std::vector<uint64_t, typename std::allocator_traits<Alloc>::template rebind_alloc<uint64_t>> table;
+    std::vector<std::mutex*> locks;
+    // Fingerprints added minus removed, by stripe of the bucket written
+    StripedCounter counts{0};
+
+    // Taken from boost hash_combine
+    template <class D>
+    inline void hash_combine(std::size_t& seed, const D& v) {
+        std::hash<D> hasher;
+        seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+    }
+
+    // std::hash is the identity for integers, so mix before slicing the hash
+    // into an index and a fingerprint (murmur3 finalizer)
+    static inline uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t hash(const T &val) {
+        size_t seed = 0;
+        hash_combine(seed, val);
+        hash_combine(seed, salt);
+        return mix(seed);
+    }
+
+    uint32_t fingerprint(uint64_t h) {
+        uint32_t fp = (uint32_t) (h >> 32) & fingerprint_mask;
+        return fp == 0 ? 1 : fp;
+    }
+
+    size_t alt_index(size_t index, uint32_t fp) {
+        return (index ^ (size_t) mix(fp)) & (num_buckets - 1);
+    }
+
+    static inline uint32_t next_random() {
+        static thread_local uint32_t state = (uint32_t) (size_t) &state ^ (uint32_t) time(NULL);
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    uint32_t get(size_t bucket, int slot) {
+        size_t bit = (bucket * SLOTS_PER_BUCKET + slot) * fingerprint_bits;
+        size_t word = bit >> 6;
+        int offset = bit & 63;
+        uint64_t fp = table[word] >> offset;
+        if (offset + fingerprint_bits > 64)
+            fp |= table[word + 1] << (64 - offset);
+        return (uint32_t) fp & fingerprint_mask;
+    }
+
+    void set(size_t bucket, int slot, uint32_t fp) {
+        size_t bit = (bucket * SLOTS_PER_BUCKET + slot) * fingerprint_bits;
+        size_t word = bit >> 6;
+        int offset = bit & 63;
+        uint64_t mask = (uint64_t) fingerprint_mask;
+        table[word] = (table[word] & ~(mask << offset)) | ((uint64_t) fp << offset);
+        if (offset + fingerprint_bits > 64) {
+            int spill = 64 - offset;
+            table[word + 1] = (table[word + 1] & ~(mask >> spill)) | ((uint64_t) fp >> spill);
+        }
+    }
+
+    int find_slot(size_t bucket, uint32_t fp) {
+        for (int slot = 0; slot < SLOTS_PER_BUCKET; slot++) {
+            if (get(bucket, slot) == fp)
+                return slot;
+        }
+        return -1;
+    }
+
+    size_t stripe_index(size_t bucket) {
+        return (bucket / BUCKETS_PER_STRIPE) % locks.size();
+    }
+
+    std::mutex *stripe(size_t bucket) {
+        return locks[stripe_index(bucket)];
+    }
+
+    // Locks are always taken in address order so pairs never deadlock
+    void acquire(size_t b0, size_t b1) {
+        std::mutex *l0 = stripe(b0);
+        std::mutex *l1 = stripe(b1);
+        if (l0 == l1) {
+            l0->lock();
+        } else if (l0 < l1) {
+            l0->lock();
+            l1->lock();
+        } else {
+            l1->lock();
+            l0->lock();
+        }
+    }
+
+    void release(size_t b0, size_t b1) {
+        std::mutex *l0 = stripe(b0);
+        std::mutex *l1 = stripe(b1);
+        l0->unlock();
+        if (l0 != l1)
+            l1->unlock();
+    }
+
+    /**
+     * Moves every fingerprint on path one hop towards its alternate bucket,
+     * starting from the end of the path, and then stores fp in the slot freed
+     * at the start. Each hop holds the locks of both buckets it touches, so
+     * a fingerprint is always visible in one of its two buckets.
+     * return: false if the path went stale, in which case every hop already
+     * made is still a valid placement and the caller retries.
+     */
+    bool apply_path(const std::vector<Step> &path, uint32_t fp) {
+        for (int k = (int) path.size() - 1; k >= 0; k--) {
+            const Step &step = path[k];
+            size_t dest = alt_index(step.bucket, step.fingerprint);
+            acquire(step.bucket, dest);
+            if (get(step.bucket, step.slot) != step.fingerprint) {
+                release(step.bucket, dest);
+                return false;
+            }
+            int free_slot = find_slot(dest, 0);
+            if (free_slot < 0) {
+                release(step.bucket, dest);
+                return false;
+            }
+            set(dest, free_slot, step.fingerprint);
+            set(step.bucket, step.slot, 0);
+            release(step.bucket, dest);
+        }
+        const Step &first = path[0];
+        std::mutex *lock = stripe(first.bucket);
+        lock->lock();
+        bool placed = get(first.bucket, first.slot) == 0;
+        if (placed) {
+            set(first.bucket, first.slot, fp);
+            counts.add(stripe_index(first.bucket), 1);
+        }
+        lock->unlock();
+        return placed;
+    }
+
+    public:
+        /**
+         * capacity: number of keys the filter should hold
+         * false_positive_rate: target rate used to size the fingerprints
+         * alloc: allocator for the fingerprint table
+         */
+        CuckooFilter(int capacity, double false_positive_rate = 0.01, const Alloc &alloc = Alloc()) : table(alloc) {
+            int bits = (int) ceil(log2(2.0 * SLOTS_PER_BUCKET / false_positive_rate));
+            fingerprint_bits = std::min(32, std::max(2, bits));
+            fingerprint_mask = fingerprint_bits == 32 ? 0xffffffffu : (1u << fingerprint_bits) - 1;
+
+            // Cuckoo filters with 4-slot buckets fill to ~95% before inserts fail
+            size_t needed = (size_t) ceil(capacity / (0.95 * SLOTS_PER_BUCKET));
+            num_buckets = BUCKETS_PER_STRIPE;
+            while (num_buckets < needed)
+                num_buckets *= 2;
+
+            size_t words = (num_buckets * SLOTS_PER_BUCKET * fingerprint_bits + 63) / 64;
+            table.assign(words, 0);
+            size_t num_stripes = std::min((size_t) MAX_STRIPES, num_buckets / BUCKETS_PER_STRIPE);
+            for (size_t i = 0; i < num_stripes; i++) {
+                locks.emplace_back(new std::mutex());
+            }
+            counts = StripedCounter(num_stripes);
+            salt = time(NULL);
+        }
+
+        ~CuckooFilter() {
+            for (auto lock : locks) {
+                delete lock;
+            }
+            locks.clear();
+            table.clear();
+        }
+
+        /**
+         * Adds val. Adding the same key twice stores two fingerprints.
+         * return: false if the filter is too full to take val
+         */
+        bool add(const T &val) {
+            uint64_t h = hash(val);
+            uint32_t fp = fingerprint(h);
+            size_t i0 = h & (num_buckets - 1);
+            size_t i1 = alt_index(i0, fp);
+            for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+                acquire(i0, i1);
+                int slot = find_slot(i0, 0);
+                if (slot >= 0) {
+                    set(i0, slot, fp);
+                    counts.add(stripe_index(i0), 1);
+                    release(i0, i1);
+                    return true;
+                } else if ((slot = find_slot(i1, 0)) >= 0) {
+                    set(i1, slot, fp);
+                    counts.add(stripe_index(i0), 1);
+                    release(i0, i1);
+                    return true;
+                }
+                release(i0, i1);
+
+                // Both buckets are full. Random-walk for a path to a free slot
+                // without changing anything, then shift entries along it.
+                std::vector<Step> path;
+                size_t bucket = next_random() & 1 ? i0 : i1;
+                bool found = false;
+                for (int kick = 0; kick < MAX_KICKS && !found; kick++) {
+                    std::mutex *lock = stripe(bucket);
+                    int victim = next_random() % SLOTS_PER_BUCKET;
+                    lock->lock();
+                    uint32_t victim_fp = get(bucket, victim);
+                    lock->unlock();
+                    if (victim_fp == 0) {
+                        // A slot freed up under us; the path so far ends here
+                        found = true;
+                        break;
+                    }
+                    path.push_back({bucket, victim, victim_fp});
+                    bucket = alt_index(bucket, victim_fp);
+                    lock = stripe(bucket);
+                    lock->lock();
+                    found = find_slot(bucket, 0) >= 0;
+                    lock->unlock();
+                }
+                if (!found)
+                    return false;
+                if (path.empty())
+                    continue;
+                if (apply_path(path, fp))
+                    return true;
+            }
+            return false;
+        }
+
+        /**
+         * Removes one fingerprint of val
+         * return: true if remove was successful
+         */
+        bool remove(const T &val) {
+            uint64_t h = hash(val);
+            uint32_t fp = fingerprint(h);
+            size_t i0 = h & (num_buckets - 1);
+            size_t i1 = alt_index(i0, fp);
+            acquire(i0, i1);
+            int slot = find_slot(i0, fp);
+            if (slot >= 0) {
+                set(i0, slot, 0);
+                counts.add(stripe_index(i0), -1);
+                release(i0, i1);
+                return true;
+            } else if ((slot = find_slot(i1, fp)) >= 0) {
+                set(i1, slot, 0);
+                counts.add(stripe_index(i0), -1);
+                release(i0, i1);
+                return true;
+            }
+            release(i0, i1);
+            return false;
+        }
+
+        /**
+         * Checks if the filter may contain val
+         * return: false if val is definitely not present
+         */
+        bool contains(const T &val) {
+            uint64_t h = hash(val);
+            uint32_t fp = fingerprint(h);
+            size_t i0 = h & (num_buckets - 1);
+            size_t i1 = alt_index(i0, fp);
+            acquire(i0, i1);
+            bool found = find_slot(i0, fp) >= 0 || find_slot(i1, fp) >= 0;
+            release(i0, i1);
+            return found;
+        }
+
+        /**
+         * Safe to call concurrently, exact once writers have finished
+         * return: The number of fingerprints in the filter
+         */
+        int size() {
+            return counts.sum();
+        }
+
+        /**
+         * return: The share of fingerprint slots in use
+         */
+        double load_factor() {
+            return counts.sum() / (double) (num_buckets * SLOTS_PER_BUCKET);
+        }
+
+        int fingerprint_size() {
+            return fingerprint_bits;
+        }
+
+        /**
+         * Upper bound on the false positive rate at full load
+         * return: 2 * SLOTS_PER_BUCKET / 2^fingerprint_bits
+         */
+        double expected_fpr() {
+            return 2.0 * SLOTS_PER_BUCKET / pow(2.0, fingerprint_bits);
+        }
+
+        /**
+         * Table memory divided by the number of stored fingerprints
+         * Thread non-safe!
+         */
+        double bits_per_key() {
+            int n = size();
+            return n == 0 ? 0.0 : (double) (table.size() * 64) / n;
+        }
+
+        /**
+         * Populates the filter to some predetermined size
+         * Thread non-safe!
+         * return: true if successful
+         */
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
+                if (!add(entry)) {
+                    std::cout << "Filter full during populate!" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+};
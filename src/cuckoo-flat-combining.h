@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <iostream>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <memory>
+
+#include "cuckoo-serial.h"
+
+/**
+ * Flat-combining front-end over CuckooSerialHashSet. Each thread publishes its
+ * operation in its own cache-line sized slot; whichever thread wins the
+ * combiner lock applies every pending operation in one pass against the
+ * serial table, so the table stays hot in one cache and no per-bucket locks
+ * change hands.
+ *
+ * A thread claims a slot the first time it uses a set and frees it when the
+ * thread exits. Threads beyond the slot count run their operations directly
+ * under the combiner lock.
+ */
+template <class T>
+class CuckooFlatCombiningHashSet {
+    // Slots per set, at least MIN_SLOTS, else SLOTS_PER_CORE per core to
+    // leave room for oversubscription
+    static const int MIN_SLOTS = 128;
+    static const int SLOTS_PER_CORE = 16;
+    // Extra passes the combiner makes while it keeps finding new requests
+    static const int COMBINE_PASSES = 3;
+    static const int SPINS_BEFORE_YIELD = 64;
+
+    enum OpType { CONTAINS, ADD, REMOVE };
+    enum SlotState { IDLE, PENDING, DONE };
+
+    struct alignas(64) Slot {
+        std::atomic<int> state;
+        std::atomic<bool> claimed;
+        int type;
+        bool result;
+        T val;
+        Slot() : state(IDLE), claimed(false), type(CONTAINS), result(false), val() {}
+    };
+
+    /**
+     * The slots, shared with the registrations of the threads using them so
+     * an exiting thread can free its slot if the set is still alive
+     */
+    struct SlotTable {
+        std::vector<Slot> slots;
+        // One past the highest slot ever claimed, the combiner scans below it
+        std::atomic<int> used;
+        SlotTable(int count) : slots(count), used(0) {}
+    };
+
+    struct Registration {
+        std::weak_ptr<SlotTable> table;
+        int slot;
+    };
+
+    /**
+     * A thread's slots in every live set it has used. Frees them when the
+     * thread exits.
+     */
+    struct Registrations {
+        std::unordered_map<unsigned long, Registration> by_set;
+        // The last set used, for the fast path
+        unsigned long last_id = ~0UL;
+        int last_slot = -1;
+
+        ~Registrations() {
+            for (auto &entry : by_set) {
+                auto table = entry.second.table.lock();
+                if (table && entry.second.slot >= 0)
+                    table->slots[entry.second.slot].claimed.store(false, std::memory_order_release);
+            }
+        }
+
+        /**
+         * Drops the registrations of sets that no longer exist
+         */
+        void prune() {
+            for (auto it = by_set.begin(); it != by_set.end();) {
+                if (it->second.table.expired())
+                    it = by_set.erase(it);
+                else
+                    ++it;
+            }
+        }
+    };
+
+    CuckooSerialHashSet<T> set;
+    std::mutex combiner;
+    std::shared_ptr<SlotTable> table;
+    // Never reused, unlike the set's address
+    const unsigned long id;
+
+    static unsigned long next_id() {
+        static std::atomic<unsigned long> ids(0);
+        return ids.fetch_add(1);
+    }
+
+    static int default_slots() {
+        return std::max<int>(MIN_SLOTS, SLOTS_PER_CORE * std::thread::hardware_concurrency());
+    }
+
+    /**
+     * Claims the first free slot
+     * return: its index, or -1 if every slot is taken
+     */
+    int claim_slot() {
+        for (int i = 0; i < (int) table->slots.size(); i++) {
+            bool expected = false;
+            if (table->slots[i].claimed.load(std::memory_order_relaxed) ||
+                    !table->slots[i].claimed.compare_exchange_strong(expected, true))
+                continue;
+            int used = table->used.load();
+            while (used <= i && !table->used.compare_exchange_weak(used, i + 1)) {}
+            return i;
+        }
+        return -1;
+    }
+
+    /**
+     * Finds the calling thread's slot, claiming one the first time it uses
+     * this set. A thread that found every slot taken keeps running without
+     * one for this set.
+     * return: the slot index, or -1 if every slot is taken
+     */
+    int my_slot() {
+        static thread_local Registrations registrations;
+        if (registrations.last_id != id) {
+            auto it = registrations.by_set.find(id);
+            if (it == registrations.by_set.end()) {
+                registrations.prune();
+                it = registrations.by_set.emplace(id, Registration{table, claim_slot()}).first;
+            }
+            registrations.last_id = id;
+            registrations.last_slot = it->second.slot;
+        }
+        return registrations.last_slot;
+    }
+
+    /**
+     * Applies one operation. val is moved into the set on add.
+     */
+    bool apply(int type, T &val) {
+        switch (type) {
+            case CONTAINS: return set.contains(val);
+            case ADD: return set.add(std::move(val));
+            default: return set.remove(val);
+        }
+    }
+
+    /**
+     * Applies every published request. Caller holds the combiner lock.
+     */
+    void combine() {
+        int active = table->used.load();
+        for (int pass = 0; pass < COMBINE_PASSES; pass++) {
+            bool found = false;
+            for (int i = 0; i < active; i++) {
+                Slot &slot = table->slots[i];
+                if (slot.state.load(std::memory_order_acquire) == PENDING) {
+                    slot.result = apply(slot.type, slot.val);
+                    slot.state.store(DONE, std::memory_order_release);
+                    found = true;
+                }
+            }
+            if (!found)
+                break;
+        }
+    }
+
+    bool execute(int type, const T &val) {
+        int index = my_slot();
+        if (index < 0) {
+            // Out of slots, run the operation directly as a combiner
+            std::lock_guard<std::mutex> guard(combiner);
+            T copy(val);
+            return apply(type, copy);
+        }
+        Slot &slot = table->slots[index];
+        slot.type = type;
+        slot.val = val;
+        slot.state.store(PENDING, std::memory_order_release);
+        for (int spins = 0; ; spins++) {
+            if (slot.state.load(std::memory_order_acquire) == DONE)
+                break;
+            if (combiner.try_lock()) {
+                combine();
+                combiner.unlock();
+                continue;
+            }
+            if (spins >= SPINS_BEFORE_YIELD)
+                std::this_thread::yield();
+        }
+        bool result = slot.result;
+        slot.state.store(IDLE, std::memory_order_relaxed);
+        return result;
+    }
+
+    public:
+        CuckooFlatCombiningHashSet(int capacity) : set(capacity), table(std::make_shared<SlotTable>(default_slots())), id(next_id()) {}
+
+        /**
+         * Adds val
+         * return: true if add was successful
+         */
+        bool add(const T &val) {
+            return execute(ADD, val);
+        }
+
+        /**
+         * Removes val
+         * return: true if remove was successful
+         */
+        bool remove(const T &val) {
+            return execute(REMOVE, val);
+        }
+
+        /**
+         * Checks if the table contains val
+         * return: true if the table contains val
+         */
+        bool contains(const T &val) {
+            return execute(CONTAINS, val);
+        }
+
+        /**
+         * Counts the number of elements in the table
+         * Thread non-safe!
+         * return: The number of elements in the table
+         */
+        int size() {
+            return set.size();
+        }
+
+        /**
+         * Populates the table to some predetermined size
+         * Thread non-safe!
+         * return: true if successful
+         */
+        bool populate(const std::vector<T> &entries) {
+            return set.populate(entries);
+        }
+};
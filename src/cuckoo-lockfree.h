@@ -0,0 +1,780 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <iostream>
+#include <functional>
+#include <ctime>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include "cuckoo-common.h"
+
+/**
+ * Epoch-based reclamation shared by every lock-free set. A thread announces
+ * the global epoch while it is inside an operation; memory unlinked in
+ * epoch e is freed once the global epoch reaches e + 2, when no thread can
+ * still be reading it. The epoch only advances when every thread inside an
+ * operation has seen the current one.
+ */
+class EpochReclaimer {
+    public:
+        static const int MAX_THREADS = 4096;
+
+    private:
+        // Retired objects per thread before trying to advance the epoch
+        static const int ADVANCE_EVERY = 64;
+
+        struct alignas(64) Record {
+            // (epoch << 1) | 1 while inside an operation, 0 outside
+            std::atomic<uint64_t> announced{0};
+            std::atomic<bool> in_use{false};
+        };
+
+        struct Retired {
+            void *object;
+            void (*deleter)(void*);
+            uint64_t epoch;
+        };
+
+        /**
+         * The calling thread's record and retired objects. Gives the record
+         * back, and its unfreed objects to the orphans, when the thread
+         * exits.
+         */
+        struct Handle {
+            int index = -1;
+            int depth = 0;
+            std::vector<Retired> retired;
+
+            ~Handle() {
+                if (index < 0)
+                    return;
+                EpochReclaimer &reclaimer = instance();
+                {
+                    std::lock_guard<std::mutex> guard(reclaimer.orphans_lock);
+                    reclaimer.orphans.insert(reclaimer.orphans.end(), retired.begin(), retired.end());
+                }
+                reclaimer.records[index].announced.store(0);
+                reclaimer.records[index].in_use.store(false);
+            }
+        };
+
+        std::atomic<uint64_t> epoch{1};
+        Record records[MAX_THREADS];
+        // Records below this have been claimed at some point; scans stop here
+        std::atomic<int> high_water{0};
+        std::mutex orphans_lock;
+        std::vector<Retired> orphans;
+
+        EpochReclaimer() {}
+
+        Handle &handle() {
+            static thread_local Handle handle;
+            if (handle.index < 0) {
+                for (int i = 0; i < MAX_THREADS; i++) {
+                    bool expected = false;
+                    if (!records[i].in_use.load() && records[i].in_use.compare_exchange_strong(expected, true)) {
+                        handle.index = i;
+                        int seen = high_water.load();
+                        while (seen < i + 1 && !high_water.compare_exchange_weak(seen, i + 1)) {}
+                        break;
+                    }
+                }
+                if (handle.index < 0) {
+                    std::cerr << "EpochReclaimer: more than " << MAX_THREADS << " threads" << std::endl;
+                    abort();
+                }
+            }
+            return handle;
+        }
+
+        /**
+         * Moves the epoch on if every thread inside an operation has
+         * announced the current one
+         */
+        void try_advance() {
+            uint64_t current = epoch.load();
+            int bound = high_water.load();
+            for (int i = 0; i < bound; i++) {
+                uint64_t announced = records[i].announced.load();
+                if ((announced & 1) && (announced >> 1) != current)
+                    return;
+            }
+            epoch.compare_exchange_strong(current, current + 1);
+        }
+
+        /**
+         * Frees the objects in retired unlinked at least two epochs before
+         * current
+         */
+        static void collect(std::vector<Retired> &retired, uint64_t current) {
+            size_t kept = 0;
+            for (size_t i = 0; i < retired.size(); i++) {
+                if (retired[i].epoch + 2 <= current)
+                    retired[i].deleter(retired[i].object);
+                else
+                    retired[kept++] = retired[i];
+            }
+            retired.resize(kept);
+        }
+
+    public:
+        static EpochReclaimer &instance() {
+            static EpochReclaimer reclaimer;
+            return reclaimer;
+        }
+
+        /**
+         * Thread non-safe! Runs at exit, once no thread reads the sets.
+         */
+        ~EpochReclaimer() {
+            for (auto &item : orphans)
+                item.deleter(item.object);
+        }
+
+        /**
+         * return: the calling thread's index in [0, MAX_THREADS), stable
+         * until it exits
+         */
+        int thread_index() {
+            return handle().index;
+        }
+
+        /**
+         * return: a bound on every thread_index() handed out so far
+         */
+        int thread_bound() {
+            return high_water.load();
+        }
+
+        /**
+         * Starts an operation: pointers read from here to exit() stay valid.
+         * Nests.
+         */
+        void enter() {
+            Handle &h = handle();
+            if (h.depth++ > 0)
+                return;
+            // A stale announcement would let the epoch move on twice under us
+            for (;;) {
+                uint64_t current = epoch.load();
+                records[h.index].announced.store((current << 1) | 1);
+                if (epoch.load() == current)
+                    return;
+            }
+        }
+
+        void exit() {
+            Handle &h = handle();
+            if (--h.depth > 0)
+                return;
+            records[h.index].announced.store(0, std::memory_order_release);
+        }
+
+        /**
+         * Frees object with deleter once no thread can be reading it. Call
+         * after object has been unlinked.
+         */
+        void retire(void *object, void (*deleter)(void*)) {
+            Handle &h = handle();
+            h.retired.push_back({object, deleter, epoch.load()});
+            if (h.retired.size() % ADVANCE_EVERY != 0)
+                return;
+            try_advance();
+            uint64_t current = epoch.load();
+            collect(h.retired, current);
+            if (orphans_lock.try_lock()) {
+                collect(orphans, current);
+                orphans_lock.unlock();
+            }
+        }
+};
+
+/**
+ * Lock-free cuckoo hash set. Each slot is one atomic word holding an entry
+ * pointer, two flag bits and a 16-bit version bumped by every write, so a
+ * CAS fails on any change since the word was read (short of 65536 writes to
+ * the slot in between).
+ *
+ * An entry moves to its slot in the other table in three steps: a COPY of
+ * it goes into the empty destination, the source is flagged MOVED, which
+ * commits the move, then the destination is unflagged and the source
+ * cleared. Until the commit the copy is invisible, and it is dropped if the
+ * source loses the entry meanwhile. Any writer meeting a flagged slot
+ * finishes or drops the move before going on, so a stalled mover blocks no
+ * one. An entry in the set is thus always visible, plain or MOVED, in
+ * exactly one of its slots.
+ *
+ * New keys only ever enter through their table0 slot, so two adds of one
+ * key both CAS the same word and cannot both succeed.
+ *
+ * contains() never writes or helps. It reads both slots twice and is done
+ * unless both changed in between, so it is wait-free unless writers keep
+ * hitting the same pair of slots.
+ *
+ * Unlinked entries and replaced tables are freed through EpochReclaimer.
+ *
+ * Resizing is not lock-free: the thread growing the table waits for the
+ * writers inside an operation to leave and keeps new ones out while it
+ * rehashes, so a writer preempted mid-operation delays it. Lookups go on
+ * against the old table meanwhile.
+ */
+template <class T>
+class CuckooLockFreeHashSet {
+    struct Entry {
+        T val;
+        size_t hash;
+        Entry(const T &val, size_t hash) : val(val), hash(hash) {}
+        Entry(T &&val, size_t hash) : val(std::move(val)), hash(hash) {}
+    };
+
+    struct Table {
+        int capacity;
+        size_t salt0;
+        size_t salt1;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots[2];
+
+        Table(int capacity, size_t salt0, size_t salt1) : capacity(capacity), salt0(salt0), salt1(salt1) {
+            for (int i = 0; i < 2; i++) {
+                slots[i].reset(new std::atomic<uint64_t>[capacity]);
+                for (int index = 0; index < capacity; index++)
+                    slots[i][index].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct alignas(64) WriterFlag {
+        std::atomic<bool> writing{false};
+    };
+
+    // Slot word: version (16 bits) | entry pointer (48 bits), with MOVED and
+    // COPY in the pointer's low bits, which alignment leaves 0
+    static const uint64_t MOVED = 1;
+    static const uint64_t COPY = 2;
+    static const int VERSION_SHIFT = 48;
+    static const uint64_t POINTER_MASK = (((uint64_t) 1 << VERSION_SHIFT) - 1) & ~(uint64_t) 7;
+    // Longest cuckoo path searched before the table is deemed full
+    static const int MAX_PATH = 128;
+
+    static_assert(sizeof(void*) == 8, "slot words pack 48-bit pointers");
+    static_assert(alignof(Entry) >= 8, "slot words use the pointer's low bits");
+
+    std::atomic<Table*> table;
+    StripedCounter counts;
+    // resize() waits for every writing flag to clear; writers keep out while
+    // resizing is set
+    std::atomic<bool> resizing{false};
+    std::mutex resize_lock;
+    std::atomic<int> resize_count{0};
+    std::unique_ptr<WriterFlag[]> writers;
+    EpochReclaimer &reclaimer = EpochReclaimer::instance();
+
+    static Entry *entry_of(uint64_t word) {
+        return reinterpret_cast<Entry*>(word & POINTER_MASK);
+    }
+
+    static bool flagged(uint64_t word) {
+        return word & (MOVED | COPY);
+    }
+
+    /**
+     * return: the word replacing old to hold entry and flags, with the next
+     * version
+     */
+    static uint64_t next_word(uint64_t old, Entry *entry, uint64_t flags = 0) {
+        return (((old >> VERSION_SHIFT) + 1) << VERSION_SHIFT) | reinterpret_cast<uint64_t>(entry) | flags;
+    }
+
+    static void delete_entry(void *entry) {
+        delete static_cast<Entry*>(entry);
+    }
+
+    static void delete_table(void *table) {
+        delete static_cast<Table*>(table);
+    }
+
+    // Taken from boost hash_combine
+    template <class D>
+    static inline void hash_combine(std::size_t& seed, const D& v) {
+        std::hash<D> hasher;
+        seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+    }
+
+    /**
+     * Mixes all bits of the salted hash (murmur3's finalizer), so a key's
+     * two slots are independent: with one entry per slot, keys sharing both
+     * slots would otherwise be common and force resizes
+     */
+    static int index(const Table *t, int i, size_t hash) {
+        uint64_t h = hash ^ (i == 0 ? t->salt0 : t->salt1);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h % t->capacity;
+    }
+
+    /**
+     * return: true if word shows val in the set, that is holds it and is
+     * not an uncommitted COPY
+     */
+    template <class K>
+    static bool holds(uint64_t word, const K &val, size_t hash) {
+        Entry *entry = entry_of(word);
+        return entry != nullptr && !(word & COPY) && entry->hash == hash && entry->val == val;
+    }
+
+    /**
+     * Brackets an operation: keeps the entries and table it reads alive,
+     * and for writers keeps resize() out until it ends
+     */
+    class Guard {
+        CuckooLockFreeHashSet &set;
+        WriterFlag *flag = nullptr;
+
+        public:
+            Guard(CuckooLockFreeHashSet &set, bool writer) : set(set) {
+                set.reclaimer.enter();
+                if (writer) {
+                    flag = &set.writers[set.reclaimer.thread_index()];
+                    set.enter_writer(*flag);
+                }
+            }
+
+            ~Guard() {
+                if (flag != nullptr)
+                    flag->writing.store(false);
+                set.reclaimer.exit();
+            }
+
+            /**
+             * Steps out of the writers so this thread can resize()
+             */
+            void pause() {
+                flag->writing.store(false);
+            }
+
+            void resume() {
+                set.enter_writer(*flag);
+            }
+    };
+
+    void enter_writer(WriterFlag &flag) {
+        for (;;) {
+            flag.writing.store(true);
+            if (!resizing.load())
+                return;
+            flag.writing.store(false);
+            while (resizing.load())
+                std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Finishes or drops the move flagged at slot (i, at), whose other end is
+     * the entry's slot in the other table. Returns once (i, at) is no longer
+     * flagged.
+     */
+    void help(Table *t, int i, int at) {
+        std::atomic<uint64_t> &slot = t->slots[i][at];
+        for (;;) {
+            uint64_t word = slot.load();
+            if (!flagged(word))
+                return;
+            Entry *entry = entry_of(word);
+            std::atomic<uint64_t> &other = t->slots[1 - i][index(t, 1 - i, entry->hash)];
+            uint64_t other_word = other.load();
+            // Ties other_word to this move: the entry may have moved on and
+            // back since word was read
+            if (slot.load() != word)
+                continue;
+            if (word & COPY) {
+                // other is the source. Once it loses the entry uncommitted,
+                // the entry was removed and never comes back.
+                if (entry_of(other_word) != entry) {
+                    slot.compare_exchange_strong(word, next_word(word, nullptr));
+                } else if (!(other_word & MOVED)) {
+                    other.compare_exchange_strong(other_word, next_word(other_word, entry, MOVED));
+                } else if (slot.compare_exchange_strong(word, next_word(word, entry))) {
+                    other.compare_exchange_strong(other_word, next_word(other_word, nullptr));
+                }
+            } else {
+                // MOVED: other is the destination and holds the entry until
+                // this slot is cleared
+                if (other_word & COPY)
+                    other.compare_exchange_strong(other_word, next_word(other_word, entry));
+                slot.compare_exchange_strong(word, next_word(word, nullptr));
+            }
+        }
+    }
+
+    /**
+     * Moves the entry at (i, from) to its slot (1 - i, to) if that is
+     * empty
+     * return: true if (i, from) is now empty
+     */
+    bool move(Table *t, int i, int from, int to) {
+        std::atomic<uint64_t> &source = t->slots[i][from];
+        std::atomic<uint64_t> &target = t->slots[1 - i][to];
+        uint64_t word = source.load();
+        Entry *entry = entry_of(word);
+        if (entry == nullptr)
+            return true;
+        if (flagged(word)) {
+            help(t, i, from);
+            return false;
+        }
+        if (index(t, 1 - i, entry->hash) != to)
+            return false;
+        uint64_t target_word = target.load();
+        if (entry_of(target_word) != nullptr) {
+            if (flagged(target_word))
+                help(t, 1 - i, to);
+            return false;
+        }
+        if (!target.compare_exchange_strong(target_word, next_word(target_word, entry, COPY)))
+            return false;
+        help(t, 1 - i, to);
+        if (flagged(source.load()))
+            help(t, i, from);
+        return entry_of(source.load()) == nullptr;
+    }
+
+    /**
+     * Empties slot (0, start) by moving its entry along a cuckoo path to an
+     * empty slot, last hop first. Retries when other writers get in the
+     * way.
+     * return: false if the path loops or runs past MAX_PATH hops
+     */
+    bool make_room(Table *t, int start) {
+        int path[MAX_PATH];
+        for (;;) {
+            path[0] = start;
+            int depth = 0;
+            bool retry = false;
+            for (;;) {
+                int i = depth % 2;
+                uint64_t word = t->slots[i][path[depth]].load();
+                if (entry_of(word) == nullptr)
+                    break;
+                if (flagged(word)) {
+                    help(t, i, path[depth]);
+                    retry = true;
+                    break;
+                }
+                if (depth + 1 == MAX_PATH)
+                    return false;
+                int next = index(t, 1 - i, entry_of(word)->hash);
+                for (int hop = 1 - i; hop < depth; hop += 2) {
+                    if (path[hop] == next)
+                        return false;
+                }
+                path[++depth] = next;
+            }
+            if (retry)
+                continue;
+            int hop = depth - 1;
+            while (hop >= 0 && move(t, hop % 2, path[hop], path[hop + 1]))
+                hop--;
+            if (hop < 0)
+                return true;
+        }
+    }
+
+    /**
+     * Grows t to twice the capacity, unless another thread already replaced
+     * it. Waits for writers to leave; the caller must not be one.
+     */
+    void resize(Table *t) {
+        std::lock_guard<std::mutex> guard(resize_lock);
+        if (table.load() != t)
+            return;
+        resizing.store(true);
+        for (int i = 0; i < reclaimer.thread_bound(); i++) {
+            while (writers[i].writing.load())
+                std::this_thread::yield();
+        }
+
+        // Writers finish every move they start, so no slot is flagged now
+        std::vector<Entry*> entries;
+        for (int i = 0; i < 2; i++) {
+            for (int slot = 0; slot < t->capacity; slot++) {
+                Entry *entry = entry_of(t->slots[i][slot].load());
+                if (entry != nullptr)
+                    entries.push_back(entry);
+            }
+        }
+        size_t salt0 = t->salt0;
+        size_t salt1 = t->salt1;
+        int capacity = t->capacity;
+        Table *grown = nullptr;
+        while (grown == nullptr) {
+            hash_combine(salt0, time(NULL));
+            hash_combine(salt1, time(NULL));
+            capacity *= 2;
+            grown = new Table(capacity, salt0, salt1);
+            for (Entry *entry : entries) {
+                if (!place(grown, entry)) {
+                    delete grown;
+                    grown = nullptr;
+                    break;
+                }
+            }
+        }
+        table.store(grown);
+        resize_count.fetch_add(1, std::memory_order_relaxed);
+        resizing.store(false);
+        reclaimer.retire(t, delete_table);
+    }
+
+    /**
+     * Puts entry into t, which no other thread can see yet
+     * return: true if successful
+     */
+    static bool place(Table *t, Entry *entry) {
+        for (int round = 0; round < MAX_PATH; round++) {
+            for (int i = 0; i < 2; i++) {
+                std::atomic<uint64_t> &slot = t->slots[i][index(t, i, entry->hash)];
+                Entry *displaced = entry_of(slot.load(std::memory_order_relaxed));
+                slot.store(reinterpret_cast<uint64_t>(entry), std::memory_order_relaxed);
+                if (displaced == nullptr)
+                    return true;
+                entry = displaced;
+            }
+        }
+        return false;
+    }
+
+    template <class U>
+    bool insert(U &&val) {
+        size_t hash = std::hash<T>()(val);
+        Entry *entry = nullptr;
+        Guard guard(*this, true);
+        for (;;) {
+            // val is moved from once entry is built
+            const T &key = entry == nullptr ? val : entry->val;
+            Table *t = table.load();
+            int index0 = index(t, 0, hash);
+            int index1 = index(t, 1, hash);
+            uint64_t word0 = t->slots[0][index0].load();
+            if (flagged(word0)) {
+                help(t, 0, index0);
+                continue;
+            }
+            uint64_t word1 = t->slots[1][index1].load();
+            if (flagged(word1)) {
+                help(t, 1, index1);
+                continue;
+            }
+            if (holds(word0, key, hash) || holds(word1, key, hash)) {
+                delete entry;
+                return false;
+            }
+            if (entry_of(word0) == nullptr) {
+                // val only reaches slot 1 through slot 0, which would fail
+                // this CAS
+                if (entry == nullptr)
+                    entry = new Entry(std::forward<U>(val), hash);
+                if (t->slots[0][index0].compare_exchange_strong(word0, next_word(word0, entry))) {
+                    counts.add(reclaimer.thread_index(), 1);
+                    return true;
+                }
+                continue;
+            }
+            if (!make_room(t, index0)) {
+                guard.pause();
+                resize(t);
+                guard.resume();
+            }
+        }
+    }
+
+    template <class K>
+    bool remove_key(const K &val) {
+        size_t hash = std::hash<K>()(val);
+        Guard guard(*this, true);
+        for (;;) {
+            Table *t = table.load();
+            int indexes[2] = {index(t, 0, hash), index(t, 1, hash)};
+            uint64_t words[2][2];
+            bool restart = false;
+            for (int round = 0; round < 2 && !restart; round++) {
+                for (int i = 0; i < 2 && !restart; i++) {
+                    words[round][i] = t->slots[i][indexes[i]].load();
+                    if (flagged(words[round][i])) {
+                        help(t, i, indexes[i]);
+                        restart = true;
+                    }
+                }
+                // Neither slot is flagged, so val is in at most one
+                for (int i = 0; i < 2 && !restart; i++) {
+                    uint64_t word = words[round][i];
+                    if (!holds(word, val, hash))
+                        continue;
+                    if (!t->slots[i][indexes[i]].compare_exchange_strong(word, next_word(word, nullptr))) {
+                        restart = true;
+                        break;
+                    }
+                    counts.add(reclaimer.thread_index(), -1);
+                    reclaimer.retire(entry_of(word), delete_entry);
+                    return true;
+                }
+            }
+            // Absent at some point unless both slots changed in between
+            if (!restart && (words[0][0] == words[1][0] || words[0][1] == words[1][1]))
+                return false;
+        }
+    }
+
+    template <class K>
+    bool contains_key(const K &val) {
+        size_t hash = std::hash<K>()(val);
+        Guard guard(*this, false);
+        for (;;) {
+            Table *t = table.load();
+            std::atomic<uint64_t> &slot0 = t->slots[0][index(t, 0, hash)];
+            std::atomic<uint64_t> &slot1 = t->slots[1][index(t, 1, hash)];
+            uint64_t word0 = slot0.load();
+            uint64_t word1 = slot1.load();
+            bool found = holds(word0, val, hash) || holds(word1, val, hash);
+            if (!found) {
+                uint64_t again0 = slot0.load();
+                uint64_t again1 = slot1.load();
+                found = holds(again0, val, hash) || holds(again1, val, hash);
+                // Both slots changed, val may have moved past both reads
+                if (!found && again0 != word0 && again1 != word1)
+                    continue;
+            }
+            // A resize meanwhile may have left t stale
+            if (table.load() != t)
+                continue;
+            return found;
+        }
+    }
+
+    public:
+        CuckooLockFreeHashSet(int capacity)
+            : counts(EpochReclaimer::MAX_THREADS), writers(new WriterFlag[EpochReclaimer::MAX_THREADS]) {
+            size_t salt0 = time(NULL);
+            size_t salt1 = salt0;
+            hash_combine(salt1, capacity);
+            table.store(new Table(std::max(1, capacity), salt0, salt1));
+        }
+
+        /**
+         * Thread non-safe!
+         */
+        ~CuckooLockFreeHashSet() {
+            Table *t = table.load();
+            for (int i = 0; i < 2; i++) {
+                for (int slot = 0; slot < t->capacity; slot++)
+                    delete entry_of(t->slots[i][slot].load());
+            }
+            delete t;
+        }
+
+        /**
+         * Adds val
+         * return: true if add was successful
+         */
+        bool add(const T &val) {
+            return insert(val);
+        }
+
+        bool add(T &&val) {
+            return insert(std::move(val));
+        }
+
+        /**
+         * Builds a value from args and adds it by move. The value is
+         * hashed and compared before it has a slot, so it is not
+         * constructed in place.
+         * return: true if add was successful
+         */
+        template <class... Args>
+        bool emplace(Args&&... args) {
+            return add(T(std::forward<Args>(args)...));
+        }
+
+        /**
+         * Removes val
+         * return: true if remove was successful
+         */
+        bool remove(const T &val) {
+            return remove_key(val);
+        }
+
+        /**
+         * Removes the value equal to key, see is_heterogeneous_key
+         * return: true if remove was successful
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool remove(const K &key) {
+            return remove_key(key);
+        }
+
+        /**
+         * Checks if the table contains val
+         * return: true if the table contains val
+         */
+        bool contains(const T &val) {
+            return contains_key(val);
+        }
+
+        /**
+         * Checks if the table contains a value equal to key, see
+         * is_heterogeneous_key
+         * return: true if the table contains it
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool contains(const K &key) {
+            return contains_key(key);
+        }
+
+        /**
+         * Safe to call while other threads add and remove; the result may
+         * then miss operations in flight. Exact once they have finished.
+         * return: The number of elements in the table
+         */
+        int size() {
+            return counts.sum();
+        }
+
+        /**
+         * return: The share of the table's slots in use
+         */
+        double load_factor() {
+            reclaimer.enter();
+            double capacity = table.load()->capacity;
+            reclaimer.exit();
+            return counts.sum() / (2.0 * capacity);
+        }
+
+        /**
+         * Every resize blocks writers until it ends, see the class comment
+         * return: The number of times the table has grown
+         */
+        int resizes() {
+            return resize_count.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Populates the table to some predetermined size
+         * return: true if successful
+         */
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
+                if (!add(entry)) {
+                    std::cout << "Duplicate entry attempted for populate!" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+};
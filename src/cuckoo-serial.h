@@ -1,24 +1,56 @@
+#pragma once
+
 #include <vector>
 #include <stdlib.h>
 #include <iostream>
 #include <functional>
 #include <ctime>
+#include <optional>
+#include <memory>
+
+#include "cuckoo-common.h"
 
-template <class T>
+/**
+ * CACHE_HASH: store each key's std::hash next to it, see CachedHash. Pays
+ * off for keys that are expensive to hash or compare, such as long strings.
+ * Alloc: allocates the rows of slots and the entries, e.g. TableAllocator
+ * for huge pages. TableAllocator hands entry-sized requests to operator new,
+ * so only the rows move to huge pages.
+ */
+template <class T, bool CACHE_HASH = false, class Alloc = std::allocator<T>>
 class CuckooSerialHashSet {
 
     // Wrapper class for entries to allow for nullptr to be the default
-    struct Entry {
-        const T val;
-        Entry(T val) : val(val) {}
+    struct Entry : CachedHash<CACHE_HASH> {
+        T val;
+        // CLOCK access bit, only maintained under FullPolicy::EvictClock
+        bool referenced;
+        Entry(const T &val, size_t hash) : CachedHash<CACHE_HASH>(hash), val(val), referenced(false) {}
+        Entry(T &&val, size_t hash) : CachedHash<CACHE_HASH>(hash), val(std::move(val)), referenced(false) {}
     };
 
+    // Displacement budget when the table cannot grow
+    static const int EVICT_LIMIT = 32;
+    // Slots per chunk of a bulk operation
+    static const int SCAN_CHUNK = 4096;
+
     int limit;
     size_t salt0;
     size_t salt1;
     int capacity;
     bool resizing = false;
-    std::vector<std::vector<Entry*>> table;
+    int count = 0;
+    // Grow once this share of the slots is in use, see max_load_factor()
+    double max_load = 1.0;
+    FullPolicy policy;
+    long evicted = 0;
+    using RowAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Entry*>;
+    using Row = std::vector<Entry*, RowAlloc>;
+    RowAlloc alloc;
+    using EntryAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Entry>;
+    using EntryTraits = std::allocator_traits<EntryAlloc>;
+    EntryAlloc entry_alloc;
+    std::vector<Row> table;
 
     // Taken from boost hash_combine
     template <class D>
@@ -27,20 +59,71 @@ class CuckooSerialHashSet {
         seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
     }
 
-    int hash0(const T val) {
+    template <class K>
+    size_t key_hash(const K &val) {
+        return std::hash<K>()(val);
+    }
+
+    /**
+     * return: the std::hash of entry's key, rehashing it only when not cached
+     */
+    size_t entry_hash(const Entry *entry) {
+        if constexpr (CACHE_HASH)
+            return entry->hash;
+        else
+            return key_hash(entry->val);
+    }
+
+    // Indexes derive from a key's std::hash and the salts, so a new salt
+    // never needs the key itself
+    int hash0(size_t hash) {
         size_t seed = 0;
-        hash_combine(seed, val);
+        hash_combine(seed, hash);
         hash_combine(seed, salt0);
         return seed % capacity;
     }
 
-    int hash1(const T val) {
+    int hash1(size_t hash) {
         size_t seed = 0;
-        hash_combine(seed, val);
+        hash_combine(seed, hash);
         hash_combine(seed, salt1);
         return seed % capacity;
     }
 
+    /**
+     * Allocates an entry through Alloc and constructs it from args
+     */
+    template <class... Args>
+    Entry* new_entry(Args&&... args) {
+        Entry *entry = EntryTraits::allocate(entry_alloc, 1);
+        try {
+            EntryTraits::construct(entry_alloc, entry, std::forward<Args>(args)...);
+        } catch (...) {
+            EntryTraits::deallocate(entry_alloc, entry, 1);
+            throw;
+        }
+        return entry;
+    }
+
+    void delete_entry(Entry *entry) {
+        EntryTraits::destroy(entry_alloc, entry);
+        EntryTraits::deallocate(entry_alloc, entry, 1);
+    }
+
+    template <class K>
+    static bool matches(const Entry *entry, const K &val, size_t hash) {
+        return entry != nullptr && entry->may_equal(hash) && entry->val == val;
+    }
+
+    /**
+     * Replaces the table with two empty rows of capacity slots
+     */
+    void new_table() {
+        table.clear();
+        for (int i = 0; i < 2; i++)
+            table.emplace_back(capacity, nullptr, alloc);
+    }
+
     /**
      * Resizes the table to be twice as big. Changes salt0 and salt1.
      */
@@ -50,7 +133,7 @@ class CuckooSerialHashSet {
         }
         resizing = true;
         bool done;
-        std::vector<std::vector<Entry*>> old_table;
+        std::vector<Row> old_table(std::move(table));
         do {
             done = true;
             // Get new salt values to change the hashes
@@ -59,76 +142,231 @@ class CuckooSerialHashSet {
 
             capacity *= 2;
             limit *= 2;
-            old_table = table;
-            table.clear();
-            for (int i = 0; i < 2; i++) {
-                std::vector<Entry*> row;
-                row.assign(capacity, nullptr);
-                table.push_back(row);
-            }
+            new_table();
 
-            // Add the elements back into the bigger table
+            // Move the entries into the bigger table. On failure they are
+            // all still owned by old_table, try again with a bigger one.
             [&] {
-                for (auto row : old_table) {
+                for (auto &row : old_table) {
                     for (auto entry : row) {
-                        if (entry != nullptr && !add(entry->val)) {
+                        if (entry != nullptr && place(entry) != nullptr) {
                             done = false;
-                            table = old_table;
                             return;
                         }
                     }
                 }
             }();
         } while (!done);
-        for (auto row : old_table) {
-            for (auto entry : row) {
-                if (entry != nullptr)
-                    delete entry;
-            }
-            row.clear();
-        }
         old_table.clear();
         resizing = false;
         return true;
     }
 
-    /** 
-     * Adds val
-     * return: true if add was successful
+    /**
+     * Puts value in the table, displacing entries along its cuckoo path.
+     * Entries move by pointer, keys are never copied.
+     * return: the entry left without a slot, or nullptr if all found one
      */
-    bool add(const Entry *value) {
-        if (contains(value->val)) {
-            return false;
-        }
+    Entry* place(Entry *value) {
         for (int i = 0; i < limit; i++) {
-            if ((value = swap(0, hash0(value->val), value)) == nullptr) {
-                return true;
-            } else if ((value = swap(1, hash1(value->val), value)) == nullptr) {
+            if ((value = swap(0, hash0(entry_hash(value)), value)) == nullptr) {
+                return nullptr;
+            } else if ((value = swap(1, hash1(entry_hash(value)), value)) == nullptr) {
+                return nullptr;
+            }
+        }
+        return value;
+    }
+
+    /**
+     * As place, but gives up after max_displacements entries have been
+     * moved and then walks the path back, so the table is left as it was.
+     * Every entry sits at its own hash in its row, which is all the walk
+     * back needs to find the previous slot.
+     * return: true if value found a slot, else it is still the caller's
+     */
+    bool place_bounded(Entry *value, int max_displacements) {
+        int i = 0;
+        for (int moves = 0; ; moves++, i = 1 - i) {
+            int index = i == 0 ? hash0(entry_hash(value)) : hash1(entry_hash(value));
+            value = swap(i, index, value);
+            if (value == nullptr)
                 return true;
+            if (moves == max_displacements) {
+                // Undo the swaps, last first. The homeless entry came out of
+                // row i, where the entry it displaced went.
+                for (; moves >= 0; moves--, i = 1 - i) {
+                    int index = i == 0 ? hash0(entry_hash(value)) : hash1(entry_hash(value));
+                    value = swap(i, index, value);
+                }
+                return false;
             }
         }
-        if (!resize())
+    }
+
+    /**
+     * Adds value, which must not be in the table yet
+     * return: true if add was successful
+     */
+    bool insert(Entry *value, std::optional<T> &victim) {
+        value = place(value);
+        if (value == nullptr) {
+            count++;
+            if (policy == FullPolicy::Resize && load_factor() > max_load)
+                resize();
+            return true;
+        }
+        if (policy != FullPolicy::Resize) {
+            Entry *dropped = evict(value);
+            if (dropped != nullptr) {
+                victim = std::move(dropped->val);
+                evicted++;
+                delete_entry(dropped);
+            } else {
+                count++;
+            }
+            return true;
+        }
+        // value is whichever entry was left without a slot
+        if (!resize()) {
+            delete_entry(value);
             return false;
-        add(value->val);
+        }
+        return insert(value, victim);
     }
 
-    public:
-        CuckooSerialHashSet(int capacity) : capacity(capacity), limit(capacity/2) {
-            for (int i = 0; i < 2; i++) {
-                std::vector<Entry*> row;
-                row.assign(capacity, nullptr);
-                table.push_back(row);
+    /**
+     * Calls visit(val) for the value of every occupied slot, with the rows
+     * split into chunks of SCAN_CHUNK slots over workers threads. The
+     * entries visit returns true for are removed.
+     * return: the number of entries removed
+     */
+    template <class Visit>
+    long scan(int workers, const Visit &visit) {
+        int per_row = (capacity + SCAN_CHUNK - 1) / SCAN_CHUNK;
+        std::atomic<long> removed(0);
+        run_chunks(2 * per_row, workers, 2L * capacity, [&](int chunk) {
+            Row &row = table[chunk / per_row];
+            int begin = chunk % per_row * SCAN_CHUNK;
+            int end = std::min(capacity, begin + SCAN_CHUNK);
+            long chunk_removed = 0;
+            for (int index = begin; index < end; index++) {
+                if (row[index] != nullptr && visit(static_cast<const T&>(row[index]->val))) {
+                    delete_entry(row[index]);
+                    row[index] = nullptr;
+                    chunk_removed++;
+                }
+            }
+            removed.fetch_add(chunk_removed, std::memory_order_relaxed);
+        });
+        count -= removed;
+        return removed;
+    }
+
+    template <class U>
+    AddStatus try_insert(U &&val, int max_displacements) {
+        size_t hash = key_hash(val);
+        if (contains_key(val, hash))
+            return AddStatus::Present;
+        Entry *entry = new_entry(std::forward<U>(val), hash);
+        if (!place_bounded(entry, std::max(0, max_displacements))) {
+            // Hand a moved-in value back
+            if constexpr (!std::is_lvalue_reference<U>::value)
+                val = std::move(entry->val);
+            delete_entry(entry);
+            return AddStatus::TableFull;
+        }
+        count++;
+        return AddStatus::Added;
+    }
+
+    template <class K>
+    Entry* find(const K &val, size_t hash) {
+        Entry *entry0 = table[0][hash0(hash)];
+        if (matches(entry0, val, hash))
+            return entry0;
+        Entry *entry1 = table[1][hash1(hash)];
+        if (matches(entry1, val, hash))
+            return entry1;
+        return nullptr;
+    }
+
+    template <class K>
+    bool remove_key(const K &val) {
+        size_t hash = key_hash(val);
+        int index0 = hash0(hash);
+        int index1 = hash1(hash);
+        if (matches(table[0][index0], val, hash)) {
+            delete_entry(table[0][index0]);
+            table[0][index0] = nullptr;
+            count--;
+            return true;
+        } else if (matches(table[1][index1], val, hash)) {
+            delete_entry(table[1][index1]);
+            table[1][index1] = nullptr;
+            count--;
+            return true;
+        }
+        return false;
+    }
+
+    template <class K>
+    bool contains_key(const K &val, size_t hash) {
+        Entry *entry = find(val, hash);
+        if (entry != nullptr && policy == FullPolicy::EvictClock)
+            entry->referenced = true;
+        return entry != nullptr;
+    }
+
+    /**
+     * Picks the entry to drop when value has no slot left. Under EvictClock
+     * an entry with a clear access bit is preferred among value and the two
+     * entries occupying its slots; the bits of those passed over are
+     * cleared, giving them a second chance.
+     * return: the entry removed from the table (possibly value itself)
+     */
+    Entry* evict(Entry *value) {
+        if (policy != FullPolicy::EvictClock || !value->referenced)
+            return value;
+        value->referenced = false;
+        for (int i = 0; i < 2; i++) {
+            int index = i == 0 ? hash0(entry_hash(value)) : hash1(entry_hash(value));
+            Entry *occupant = table[i][index];
+            if (occupant == nullptr) {
+                table[i][index] = value;
+                return nullptr;
             }
+            if (!occupant->referenced) {
+                table[i][index] = value;
+                return occupant;
+            }
+            occupant->referenced = false;
+        }
+        return value;
+    }
+
+    public:
+        /**
+         * policy: whether a full table grows or evicts. When evicting, memory
+         * stays at capacity and each add makes at most EVICT_LIMIT
+         * displacement rounds.
+         * alloc: allocator for the rows of slots and the entries
+         */
+        CuckooSerialHashSet(int capacity, FullPolicy policy = FullPolicy::Resize, const Alloc &alloc = Alloc())
+            : capacity(capacity), limit(capacity/2), policy(policy), alloc(alloc), entry_alloc(alloc) {
+            if (policy != FullPolicy::Resize)
+                limit = std::min(limit, EVICT_LIMIT);
+            new_table();
             salt0 = time(NULL);
             salt1 = salt0;
             hash_combine(salt1, capacity);
         }
 
         ~CuckooSerialHashSet() {
-            for (auto row : table) {
+            for (auto &row : table) {
                 for (auto entry : row) {
                     if (entry != nullptr) {
-                        delete entry;
+                        delete_entry(entry);
                     }
                 }
                 row.clear();
@@ -150,79 +388,208 @@ class CuckooSerialHashSet {
          * Adds val
          * return: true if add was successful
          */
-        bool add(const T val) {
-            if (contains(val)) {
+        bool add(const T &val) {
+            std::optional<T> victim;
+            return add(val, victim);
+        }
+
+        bool add(T &&val) {
+            std::optional<T> victim;
+            return add(std::move(val), victim);
+        }
+
+        /** 
+         * Adds val. If the table is full and does not resize, an entry is
+         * dropped to make room and stored in victim. The victim can be val
+         * itself.
+         * return: true if add was successful
+         */
+        bool add(const T &val, std::optional<T> &victim) {
+            size_t hash = key_hash(val);
+            if (contains_key(val, hash))
                 return false;
-            }
-            Entry *value = new Entry(val);
-            for (int i = 0; i < limit; i++) {
-                if ((value = swap(0, hash0(value->val), value)) == nullptr) {
-                    return true;
-                } else if ((value = swap(1, hash1(value->val), value)) == nullptr) {
-                    return true;
-                }
-            }
-            if (!resize())
+            return insert(new_entry(val, hash), victim);
+        }
+
+        bool add(T &&val, std::optional<T> &victim) {
+            size_t hash = key_hash(val);
+            if (contains_key(val, hash))
                 return false;
-            add(value->val);
+            return insert(new_entry(std::move(val), hash), victim);
+        }
+
+        /**
+         * Adds val in bounded time: at most max_displacements entries are
+         * moved, and the table never resizes or evicts. The load factor
+         * limit is not checked either; watch load_factor() and grow() when
+         * convenient.
+         * return: Added, Present, or TableFull with the table unchanged
+         */
+        AddStatus try_add(const T &val, int max_displacements) {
+            return try_insert(val, max_displacements);
+        }
+
+        AddStatus try_add(T &&val, int max_displacements) {
+            return try_insert(std::move(val), max_displacements);
+        }
+
+        /**
+         * Doubles the capacity, e.g. after try_add reported TableFull
+         */
+        void grow() {
+            resize();
+        }
+
+        /**
+         * Calls fn(val) for every value. The rows are split over workers
+         * threads, so fn must be safe to call from several at once.
+         */
+        template <class Fn>
+        void for_each(const Fn &fn, int workers = default_workers()) {
+            scan(workers, [&](const T &val) {
+                fn(val);
+                return false;
+            });
+        }
+
+        /**
+         * Removes every value pred(val) holds for. The rows are split over
+         * workers threads, so pred must be safe to call from several at
+         * once.
+         * return: the number of values removed
+         */
+        template <class Pred>
+        long erase_if(const Pred &pred, int workers = default_workers()) {
+            return scan(workers, pred);
+        }
+
+        /**
+         * Adds every value of other, which can be any set with for_each.
+         * The adds themselves run on the calling thread.
+         * return: the number of values added
+         */
+        template <class Set>
+        long merge(Set &other) {
+            if ((void*) &other == (void*) this)
+                return 0;
+            long added = 0;
+            other.for_each([&](const T &val) {
+                added += add(val);
+            }, 1);
+            return added;
+        }
+
+        /**
+         * Removes every value other does not contain. other is probed from
+         * workers threads at once and must not change meanwhile.
+         * return: the number of values removed
+         */
+        template <class Set>
+        long intersect(Set &other, int workers = default_workers()) {
+            if ((void*) &other == (void*) this)
+                return 0;
+            return erase_if([&](const T &val) { return !other.contains(val); }, workers);
+        }
+
+        /**
+         * Removes every value other contains. other is probed from workers
+         * threads at once and must not change meanwhile.
+         * return: the number of values removed
+         */
+        template <class Set>
+        long difference(Set &other, int workers = default_workers()) {
+            if ((void*) &other == (void*) this)
+                return erase_if([](const T&) { return true; }, workers);
+            return erase_if([&](const T &val) { return other.contains(val); }, workers);
+        }
+
+        /**
+         * Builds a value from args and adds it by move. The value is
+         * hashed and compared before it has a slot, so it is not
+         * constructed in place.
+         * return: true if add was successful
+         */
+        template <class... Args>
+        bool emplace(Args&&... args) {
+            return add(T(std::forward<Args>(args)...));
         }
 
         /** 
          * Removes val
          * return: true if remove was successful
          */
-        bool remove(const T val) {
-            int index0 = hash0(val);
-            int index1 = hash1(val);
-            if (table[0][index0] != nullptr && table[0][index0]->val == val) {
-                delete table[0][index0];
-                table[0][index0] = nullptr;
-                return true;
-            } else if (table[1][index1] != nullptr && table[1][index1]->val == val) {
-                delete table[1][index1];
-                table[1][index1] = nullptr;
-                return true;
-            }
-            return false;
+        bool remove(const T &val) {
+            return remove_key(val);
+        }
+
+        /**
+         * Removes the value equal to key, see is_heterogeneous_key
+         * return: true if remove was successful
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool remove(const K &key) {
+            return remove_key(key);
         }
 
         /** 
          * Checks if the table contains val
          * return: true if the table contains val
          */
-        bool contains(const T val) {
-            int index0 = hash0(val);
-            int index1 = hash1(val);
-            if (table[0][index0] != nullptr && table[0][index0]->val == val) {
-                return true;
-            } else if (table[1][index1] != nullptr && table[1][index1]->val == val) {
-                return true;
-            }
-            return false;
+        bool contains(const T &val) {
+            return contains_key(val, key_hash(val));
+        }
+
+        /**
+         * Checks if the table contains a value equal to key, see
+         * is_heterogeneous_key
+         * return: true if the table contains it
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool contains(const K &key) {
+            return contains_key(key, key_hash(key));
+        }
+
+        /**
+         * return: The number of entries dropped to make room so far
+         */
+        long evictions() {
+            return evicted;
         }
 
         /**
-         * Counts the number of elements in the table
          * return: The number of elements in the table
          */
         int size() {
-            int size = 0;
-            for (auto row : table) {
-                for (auto entry : row) {
-                    if (entry != nullptr) {
-                        size++;
-                    }
-                }
-            }
-            return size;
+            return count;
+        }
+
+        /**
+         * return: The share of the table's slots in use
+         */
+        double load_factor() {
+            return (double) count / (2.0 * capacity);
+        }
+
+        double max_load_factor() {
+            return max_load;
+        }
+
+        /**
+         * Makes add grow the table as soon as the load factor passes
+         * max_load_factor, instead of only once displacement fails. Cuckoo
+         * tables with one slot per index fill to about 0.5. The default of
+         * 1.0 never triggers.
+         */
+        void max_load_factor(double max_load_factor) {
+            max_load = max_load_factor;
         }
 
         /**
          * Populates the table to some predetermined size
          * return: true if successful
          */
-        bool populate(const std::vector<T> entries) {
-            for (T entry : entries) {
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
                 if (!add(entry)) {
                     std::cout << "Duplicate entry attempted for populate!" << std::endl;
                     return false;
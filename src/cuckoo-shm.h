@@ -0,0 +1,466 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <functional>
+#include <ctime>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <type_traits>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cuckoo-common.h"
+
+/**
+ * The concurrent cuckoo set laid out in one POSIX shared memory segment, so
+ * several processes can attach to a single copy and add, remove and look up
+ * concurrently. Probe sets are fixed arrays of PROBE_SIZE values, found by
+ * offsets from the segment's start rather than by pointers, and the stripe
+ * locks are process-shared robust mutexes, one per probe set. The capacity
+ * is fixed when the segment is created: a full table makes add fail rather
+ * than resize.
+ * T must be trivially copyable and hash the same in every process.
+ */
+template <class T>
+class CuckooSharedHashSet {
+    static_assert(std::is_trivially_copyable<T>::value, "shared values are copied byte for byte");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "atomics in shared memory must be lock-free");
+
+    static const uint32_t MAGIC = 0x4d485343; // "CSHM"
+    static const uint32_t VERSION = 1;
+    static const int PROBE_SIZE = 8;
+    static const int THRESHOLD = PROBE_SIZE/2;
+    // Relocation rounds of add
+    static const int RELOCATE_LIMIT = 32;
+    static const int COUNT_SLOTS = 64;
+
+    struct ProbeSet {
+        uint32_t count;
+        T values[PROBE_SIZE];
+    };
+
+    struct alignas(64) Count {
+        std::atomic<long> value;
+    };
+
+    // Written once by the creator; ready is set last
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t value_size;
+        uint32_t capacity;
+        uint64_t salt0;
+        uint64_t salt1;
+        uint64_t segment_size;
+        uint64_t locks_offset;
+        uint64_t counts_offset;
+        uint64_t sets_offset;
+        std::atomic<uint32_t> ready;
+    };
+
+    char *base = nullptr;
+    size_t mapping_size = 0;
+
+    Header &header() {
+        return *reinterpret_cast<Header*>(base);
+    }
+
+    pthread_mutex_t &lock_at(int i, int index) {
+        return reinterpret_cast<pthread_mutex_t*>(base + header().locks_offset)[i * header().capacity + index];
+    }
+
+    ProbeSet &probe_set(int i, int index) {
+        return reinterpret_cast<ProbeSet*>(base + header().sets_offset)[i * header().capacity + index];
+    }
+
+    Count &count_at(size_t stripe) {
+        return reinterpret_cast<Count*>(base + header().counts_offset)[stripe % COUNT_SLOTS];
+    }
+
+    static size_t segment_size(int capacity, size_t &locks_offset, size_t &counts_offset, size_t &sets_offset) {
+        locks_offset = round_up(sizeof(Header));
+        counts_offset = round_up(locks_offset + 2 * capacity * sizeof(pthread_mutex_t));
+        sets_offset = round_up(counts_offset + COUNT_SLOTS * sizeof(Count));
+        return sets_offset + 2 * capacity * sizeof(ProbeSet);
+    }
+
+    static size_t round_up(size_t bytes) {
+        return (bytes + 63) / 64 * 64;
+    }
+
+    // Taken from boost hash_combine
+    template <class D>
+    inline void hash_combine(std::size_t& seed, const D& v) {
+        std::hash<D> hasher;
+        seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+    }
+
+    int hash0(const T &val) {
+        size_t seed = 0;
+        hash_combine(seed, std::hash<T>()(val));
+        hash_combine(seed, (size_t) header().salt0);
+        return abs((int) seed);
+    }
+
+    int hash1(const T &val) {
+        size_t seed = 0;
+        hash_combine(seed, std::hash<T>()(val));
+        hash_combine(seed, (size_t) header().salt1);
+        return abs((int) seed);
+    }
+
+    int full_hash(int i, const T &val) {
+        return i == 0 ? hash0(val) : hash1(val);
+    }
+
+    /**
+     * Locks table i's stripe index. A lock left behind by a process that
+     * died holding it is taken over; the probe set it guarded may then be
+     * half updated.
+     */
+    void lock(int i, int index) {
+        if (pthread_mutex_lock(&lock_at(i, index)) == EOWNERDEAD)
+            pthread_mutex_consistent(&lock_at(i, index));
+    }
+
+    void unlock(int i, int index) {
+        pthread_mutex_unlock(&lock_at(i, index));
+    }
+
+    void acquire(int hash0, int hash1) {
+        lock(0, hash0 % header().capacity);
+        lock(1, hash1 % header().capacity);
+    }
+
+    void release(int hash0, int hash1) {
+        unlock(0, hash0 % header().capacity);
+        unlock(1, hash1 % header().capacity);
+    }
+
+    static int find(const ProbeSet &set, const T &val) {
+        for (uint32_t k = 0; k < set.count; k++) {
+            if (set.values[k] == val)
+                return k;
+        }
+        return -1;
+    }
+
+    static void erase(ProbeSet &set, int k) {
+        memmove(&set.values[k], &set.values[k + 1], (set.count - k - 1) * sizeof(T));
+        set.count--;
+    }
+
+    /**
+     * Moves values out of the overfull probe set (i, hi) until some probe
+     * set on the path is back under THRESHOLD, for at most rounds moves. As
+     * in CuckooConcurrentHashSet.
+     * return: true if successful
+     */
+    bool relocate(int i, int hi, int rounds) {
+        int j = 1 - i;
+        for (int round = 0; round < rounds; round++) {
+            // Hash the oldest value under its own stripe, the set may be
+            // changing underneath
+            int full[2];
+            lock(i, hi);
+            if (probe_set(i, hi).count == 0) {
+                unlock(i, hi);
+                return true;
+            }
+            T front = probe_set(i, hi).values[0];
+            unlock(i, hi);
+            full[0] = hash0(front);
+            full[1] = hash1(front);
+            acquire(full[0], full[1]);
+            int hj = full[j] % header().capacity;
+            ProbeSet &iSet = probe_set(i, hi);
+            ProbeSet &jSet = probe_set(j, hj);
+            // Whatever value is at the front now can move if it shares the
+            // pair of probe sets, since those are the ones locked
+            if (iSet.count > 0 && full_hash(j, iSet.values[0]) == full[j]) {
+                if (jSet.count < PROBE_SIZE) {
+                    jSet.values[jSet.count++] = iSet.values[0];
+                    erase(iSet, 0);
+                    bool done = jSet.count <= THRESHOLD;
+                    release(full[0], full[1]);
+                    if (done)
+                        return true;
+                    i = 1 - i;
+                    hi = hj;
+                    j = 1 - j;
+                } else {
+                    T oldest = iSet.values[0];
+                    erase(iSet, 0);
+                    iSet.values[iSet.count++] = oldest;
+                    release(full[0], full[1]);
+                    return false;
+                }
+            } else if (iSet.count >= THRESHOLD) {
+                release(full[0], full[1]);
+            } else {
+                release(full[0], full[1]);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool map(int fd, size_t size, const char *name) {
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            perror(name);
+            return false;
+        }
+        base = static_cast<char*>(p);
+        mapping_size = size;
+        return true;
+    }
+
+    void detach() {
+        if (base != nullptr)
+            munmap(base, mapping_size);
+        base = nullptr;
+        mapping_size = 0;
+    }
+
+    public:
+        CuckooSharedHashSet() {}
+
+        /**
+         * Unmaps the segment. It lives on until unlink(), for other
+         * processes to attach to.
+         */
+        ~CuckooSharedHashSet() {
+            detach();
+        }
+
+        CuckooSharedHashSet(const CuckooSharedHashSet&) = delete;
+        CuckooSharedHashSet& operator=(const CuckooSharedHashSet&) = delete;
+
+        /**
+         * Creates the segment name (as for shm_open, e.g. "/cuckoo") holding
+         * an empty set of capacity probe sets per table, and attaches to it.
+         * Fails if the segment exists.
+         * return: true if successful
+         */
+        bool create(const char *name, int capacity) {
+            detach();
+            size_t locks_offset, counts_offset, sets_offset;
+            size_t size = segment_size(capacity, locks_offset, counts_offset, sets_offset);
+            int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0) {
+                perror(name);
+                return false;
+            }
+            // The new segment reads as zeros: empty probe sets, zero counts
+            if (ftruncate(fd, size) != 0) {
+                perror(name);
+                close(fd);
+                shm_unlink(name);
+                return false;
+            }
+            if (!map(fd, size, name)) {
+                shm_unlink(name);
+                return false;
+            }
+
+            Header &h = header();
+            h.magic = MAGIC;
+            h.version = VERSION;
+            h.value_size = sizeof(T);
+            h.capacity = capacity;
+            h.segment_size = size;
+            h.locks_offset = locks_offset;
+            h.counts_offset = counts_offset;
+            h.sets_offset = sets_offset;
+            size_t salt0 = time(NULL);
+            size_t salt1 = salt0;
+            hash_combine(salt1, capacity);
+            h.salt0 = salt0;
+            h.salt1 = salt1;
+
+            pthread_mutexattr_t attr;
+            pthread_mutexattr_init(&attr);
+            pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+            for (int i = 0; i < 2; i++) {
+                for (int index = 0; index < capacity; index++)
+                    pthread_mutex_init(&lock_at(i, index), &attr);
+            }
+            pthread_mutexattr_destroy(&attr);
+            h.ready.store(1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Attaches to the segment name made by create(), waiting for its
+         * creator to finish setting it up
+         * return: true if successful
+         */
+        bool attach(const char *name) {
+            detach();
+            int fd = shm_open(name, O_RDWR, 0);
+            if (fd < 0) {
+                perror(name);
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)) {
+                std::cerr << name << ": not a shared cuckoo set" << std::endl;
+                close(fd);
+                return false;
+            }
+            if (!map(fd, st.st_size, name))
+                return false;
+            Header &h = header();
+            while (h.ready.load(std::memory_order_acquire) == 0)
+                std::this_thread::yield();
+            if (h.magic != MAGIC || h.version != VERSION || h.value_size != sizeof(T) || h.segment_size != mapping_size) {
+                std::cerr << name << ": not a shared cuckoo set of this type" << std::endl;
+                detach();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Removes the segment name; processes attached keep their mapping
+         * return: true if successful
+         */
+        static bool unlink(const char *name) {
+            return shm_unlink(name) == 0;
+        }
+
+        /**
+         * return: the size of the shared segment in bytes
+         */
+        size_t segment_bytes() {
+            return mapping_size;
+        }
+
+        /**
+         * Adds val, moving at most max_displacements values to make room.
+         * Never resizes: the capacity is fixed.
+         * return: Added, Present, or TableFull with the table unchanged
+         */
+        AddStatus try_add(const T &val, int max_displacements) {
+            int full0 = hash0(val);
+            int full1 = hash1(val);
+            acquire(full0, full1);
+            int h0 = full0 % header().capacity;
+            int h1 = full1 % header().capacity;
+            ProbeSet &set0 = probe_set(0, h0);
+            ProbeSet &set1 = probe_set(1, h1);
+            if (find(set0, val) >= 0 || find(set1, val) >= 0) {
+                release(full0, full1);
+                return AddStatus::Present;
+            }
+            int i;
+            if (set0.count < THRESHOLD || set1.count < THRESHOLD) {
+                i = set0.count < THRESHOLD ? 0 : 1;
+            } else if (set0.count < PROBE_SIZE) {
+                i = 0;
+            } else if (set1.count < PROBE_SIZE) {
+                i = 1;
+            } else {
+                release(full0, full1);
+                return AddStatus::TableFull;
+            }
+            ProbeSet &set = i == 0 ? set0 : set1;
+            bool overflow = set.count >= THRESHOLD;
+            set.values[set.count++] = val;
+            count_at(full0).value.fetch_add(1, std::memory_order_relaxed);
+            release(full0, full1);
+            if (overflow)
+                relocate(i, i == 0 ? h0 : h1, max_displacements);
+            return AddStatus::Added;
+        }
+
+        /**
+         * Adds val
+         * return: true if add was successful, false if val was present or
+         * both its probe sets are full
+         */
+        bool add(const T &val) {
+            return try_add(val, RELOCATE_LIMIT) == AddStatus::Added;
+        }
+
+        /**
+         * Removes val
+         * return: true if remove was successful
+         */
+        bool remove(const T &val) {
+            int full0 = hash0(val);
+            int full1 = hash1(val);
+            acquire(full0, full1);
+            for (int i = 0; i < 2; i++) {
+                ProbeSet &set = probe_set(i, (i == 0 ? full0 : full1) % header().capacity);
+                int k = find(set, val);
+                if (k >= 0) {
+                    erase(set, k);
+                    count_at(full0).value.fetch_add(-1, std::memory_order_relaxed);
+                    release(full0, full1);
+                    return true;
+                }
+            }
+            release(full0, full1);
+            return false;
+        }
+
+        /**
+         * Checks if the table contains val
+         * return: true if the table contains val
+         */
+        bool contains(const T &val) {
+            int full0 = hash0(val);
+            int full1 = hash1(val);
+            acquire(full0, full1);
+            bool found = find(probe_set(0, full0 % header().capacity), val) >= 0 ||
+                         find(probe_set(1, full1 % header().capacity), val) >= 0;
+            release(full0, full1);
+            return found;
+        }
+
+        /**
+         * As CuckooConcurrentHashSet::size(), counting every process's
+         * operations
+         * return: The number of elements in the table
+         */
+        int size() {
+            long total = 0;
+            for (int slot = 0; slot < COUNT_SLOTS; slot++)
+                total += count_at(slot).value.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        /**
+         * return: The share of the table's slots (PROBE_SIZE per probe set)
+         * in use
+         */
+        double load_factor() {
+            return size() / (2.0 * header().capacity * PROBE_SIZE);
+        }
+
+        /**
+         * Populates the table to some predetermined size
+         * return: true if successful
+         */
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
+                if (!add(entry)) {
+                    std::cout << "Duplicate entry or full table for populate!" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+};
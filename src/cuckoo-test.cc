@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <iostream>
+#include <iomanip>
 #include <vector>
 #include <unordered_set>
 #include <chrono>
@@ -7,23 +8,90 @@
 #include <assert.h>
 #include <mutex>
 #include <thread>
+#include <string>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <optional>
 
 #include "cuckoo-serial.h"
 #include "cuckoo-concurrent.h"
 #include "cuckoo-transactional.h"
+#include "cuckoo-filter.h"
+#include "cuckoo-flat-combining.h"
+#include "cuckoo-async.h"
+#include "cuckoo-shm.h"
+#include "cuckoo-lockfree.h"
+#include "cuckoo-adaptive.h"
+#include "unordered-set-baseline.h"
+#include "thread-pinning.h"
+#include "op-stream.h"
+#include "perf-counters.h"
 
 const int NUM_OPS = 10000000;
 const int CAPACITY = 15000;
 const int KEY_MAX = 10000;
 const int INITIAL_SIZE = KEY_MAX/2;
 const int NUM_THREADS = 8;
+const double FILTER_FPR = 0.01;
+const int FILTER_PROBES = 1000000;
+// Flat combining comparison grid, with fewer ops per run to keep it short
+const int COMPARE_OPS = 1000000;
+const int COMPARE_THREADS[] = {1, 2, 4, 8, 16};
+const int COMPARE_WRITE_PCT[] = {0, 10, 50, 100};
+// Hot-key cache: skewed lookups over a key space ten times the cache size
+const int CACHE_OPS = 1000000;
+const int CACHE_CAPACITY = 4096;
+const int CACHE_KEYS = 100000;
+const double CACHE_SKEW = 0.99;
+// Scalability sweep, ops per thread at each point, and the capacity of its
+// sets: at this load the lock-free set, whose resize blocks writers, never
+// grows
+const int SWEEP_OPS = 1000000;
+const int SWEEP_CAPACITY = 4 * KEY_MAX;
+const uint64_t DEFAULT_SEED = 375;
+// Write-behind comparison, ops per producer thread
+const int ASYNC_OPS = 1000000;
+const int ASYNC_APPLIERS = 2;
+// Open-loop curves: seconds each offered load is held for, at most
+// OPEN_LOOP_OPS per thread
+const double OPEN_LOOP_SECONDS = 0.5;
+const int OPEN_LOOP_OPS = 1000000;
+const double OPEN_LOOP_LOADS[] = {100000, 250000, 500000, 1000000, 2000000, 4000000};
+// Multi-process mode: shared memory segment, ops per process
+const char *const SHM_NAME = "/cuckoo-test";
+const int SHM_OPS = 1000000;
+// Oversubscription: sweep up to this many threads per core
+const int OVERSUB_PER_CORE = 8;
+// Adaptive set hand-off: ops per thread, ops a helper runs per attachment,
+// and its pause between attachments so the steady worker runs solo
+const int HANDOFF_OPS = 1000000;
+const int HANDOFF_BURST = 1000;
+const int HANDOFF_PAUSE_US = 20;
+const int HANDOFF_HELPERS = 3;
 
-struct Operation {
-    int val;
-    int type; // 0 => contains, 1 => add, 2 => remove
-    Operation(int val, int type) : val(val), type(type) {}
+/**
+ * Command line options shared by every mode
+ */
+struct Options {
+    uint64_t seed = DEFAULT_SEED;
+    // Save the generated workload to / map the workload from these files
+    const char *workload_out = nullptr;
+    const char *workload_in = nullptr;
+    std::vector<int> thread_counts;
+    PinPolicy pin_policy = PinPolicy::Compact;
+    // Count hardware events around each thread's run
+    bool perf = false;
+    // Open-loop offered loads (total ops/sec) and arrival process
+    std::vector<double> offered_loads;
+    bool poisson = true;
 };
 
+Options options;
+
 struct Metrics {
     long long exec_time = 0;
     int contains_hit = 0;
@@ -32,218 +100,1176 @@ struct Metrics {
     int add_miss = 0;
     int remove_hit = 0;
     int remove_miss = 0;
+    PerfSample perf;
 };
 
 /**
- * Generates num_entires unique entries
+ * Generates the initial entries and one operation stream per thread.
+ * By default 50% contains, 25% add, 25% remove. write_pct is split evenly
+ * between add and remove.
+ * With guarenteed success for add and remove operations, size of table should stay
+ * relatively the same.
  */
-std::vector<int> generate_entries(int num_entries) {
-    auto seed = std::chrono::high_resolution_clock::now()
-            .time_since_epoch()
-            .count();
-	static thread_local std::mt19937 generator(seed);
-    std::uniform_int_distribution<int> entry_generator(0, KEY_MAX);
-
-    std::unordered_set<int> entries;
-    while (entries.size() < num_entries) {
-        entries.insert(entry_generator(generator));
-    }
-    return {entries.begin(), entries.end()};
-}
-
-std::vector<Operation> generate_operations(int num_ops, std::vector<int> *entries) {
-    // 50% contains, 25% add, 25% remove
-    // With guarenteed success for add and remove operations, size of table should stay
-    // relatively the same.
-    auto seed = std::chrono::high_resolution_clock::now()
-            .time_since_epoch()
-            .count();
-	static thread_local std::mt19937 generator(seed);
-    std::uniform_int_distribution<int> distribution_percentage(0, 100);
-    std::uniform_int_distribution<int> distribution_entries(0, KEY_MAX);
-    std::vector<Operation> ops;
-    for (int i = 0; i < num_ops; i++) {
-        std::uniform_int_distribution<int> distribution_existing_entries(0, entries->size()-1);
-        int which_op = distribution_percentage(generator);
-        if (which_op <= 50) {
-            // contains
-            ops.emplace_back(distribution_entries(generator), 0);
-        } else if (which_op <= 75) {
-            // add
-            int entry = distribution_entries(generator);
-            entries->push_back(entry);
-            ops.emplace_back(entry, 1);
-        } else {
-            // remove
-            ops.emplace_back(entries->at(distribution_existing_entries(generator)), 2);
-        }
-    }
-    return ops;
+bool generate_workload(Workload &workload, int num_threads, int num_ops, int write_pct = 50) {
+    return workload.generate(num_threads, num_ops, INITIAL_SIZE, KEY_MAX, write_pct, options.seed);
 }
 
 /**
- * Runs a workload for cuckoo serial
+ * Applies ops to set and records the outcome of each in metrics
  */
-void do_work_serial(CuckooSerialHashSet<int> *cuckoo_serial, std::vector<Operation> ops, Metrics &metrics) {
-    // Start doing work
-    long long exec_time_start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    for (auto op : ops) {
-        // std::cout << "val: " << op.val << ", type: " << op.type << std::endl;
-        switch (op.type) {
-            // Contains
-            case 0:
-                if (cuckoo_serial->contains(op.val))
+template <class Set>
+void run_operations(Set *set, const OpSlice &ops, Metrics &metrics) {
+    for (uint32_t op : ops) {
+        int val = op_key(op);
+        switch (op_type(op)) {
+            case OP_CONTAINS:
+                if (set->contains(val))
                     metrics.contains_hit++;
                 else
                     metrics.contains_miss++;
                 break;
-            // Insert
-            case 1:
-                if (cuckoo_serial->add(op.val))
+            case OP_ADD:
+                if (set->add(val))
                     metrics.add_hit++;
                 else
                     metrics.add_miss++;
                 break;
-            // Remove
             default:
-                if (cuckoo_serial->remove(op.val))
+                if (set->remove(val))
                     metrics.remove_hit++;
                 else
                     metrics.remove_miss++;
                 break;
         }
     }
+}
+
+/**
+ * Runs ops as run_operations, timing them and, with -P, counting hardware
+ * events of the calling thread. The counters are opened outside the timed
+ * region.
+ */
+template <class Set>
+void measure_operations(Set *set, const OpSlice &ops, Metrics &metrics) {
+    std::optional<PerfCounterSet> counters;
+    if (options.perf) {
+        counters.emplace();
+        counters->start();
+    }
+    long long exec_time_start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    run_operations(set, ops, metrics);
     long long exec_time_end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    if (counters) {
+        counters->stop();
+        metrics.perf = counters->sample();
+    }
 	metrics.exec_time = exec_time_end - exec_time_start;
 }
 
 /**
- * Runs a workload for cuckoo concurrent
+ * With -P, prints sample's events per operation
  */
-void do_work_concurrent(CuckooConcurrentHashSet<int> *cuckoo_concurrent, std::vector<int> concurrent_entries, std::vector<Metrics> *concurrent_metrics) {
+void print_perf(const char *name, const PerfSample &sample, long long ops) {
+    if (!options.perf)
+        return;
+    // Context switches still come from getrusage, print them regardless
+    if (!sample.any_hardware())
+        std::cout << name << " perf counters: unavailable (perf_event_paranoid or no PMU access)" << std::endl;
+    // Switches per op can be tiny, keep significant digits
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::defaultfloat << name << " per op:";
+    for (int event = 0; event < NUM_PERF_EVENTS; event++) {
+        std::cout << "  " << PERF_EVENT_NAMES[event] << " ";
+        if (sample.available[event])
+            std::cout << std::setprecision(4) << (double) sample.counts[event] / ops;
+        else
+            std::cout << "n/a";
+    }
+    if (sample.available[PERF_CYCLES] && sample.available[PERF_INSTRUCTIONS] && sample.counts[PERF_CYCLES] > 0)
+        std::cout << "  ipc " << std::setprecision(2) << (double) sample.counts[PERF_INSTRUCTIONS] / sample.counts[PERF_CYCLES];
+    std::cout << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+/**
+ * Runs a workload for cuckoo serial
+ */
+void do_work_serial(CuckooSerialHashSet<int> *cuckoo_serial, const OpSlice &ops, Metrics &metrics) {
+    measure_operations(cuckoo_serial, ops, metrics);
+}
+
+/**
+ * Runs a workload for cuckoo concurrent (or any set with the same interface)
+ */
+template <class Set>
+void do_work_concurrent(Set *cuckoo_concurrent, const OpSlice ops, std::vector<Metrics> *concurrent_metrics) {
+    static std::mutex metrics_lock;
     Metrics metrics = {};
-    auto ops = generate_operations(NUM_OPS, &concurrent_entries);
-    // Start doing work
+    measure_operations(cuckoo_concurrent, ops, metrics);
+
+    std::lock_guard<std::mutex> guard(metrics_lock);
+    concurrent_metrics->push_back(metrics);
+}
+
+/**
+ * Runs every operation on a thread non-safe set under one global lock, a
+ * stand-in for the transactions CuckooTransactionalHashSet does not have.
+ * Builds and owns its set, so it can stand in wherever a set is constructed.
+ */
+template <class Set>
+class GlobalLockAdapter {
+    Set *set;
+    std::mutex lock;
+
+    public:
+        GlobalLockAdapter(int capacity) : set(new Set(capacity)) {}
+
+        ~GlobalLockAdapter() {
+            delete set;
+        }
+
+        bool populate(const std::vector<int> &entries) {
+            return set->populate(entries);
+        }
+
+        bool add(int val) {
+            std::lock_guard<std::mutex> guard(lock);
+            return set->add(val);
+        }
+
+        bool remove(int val) {
+            std::lock_guard<std::mutex> guard(lock);
+            return set->remove(val);
+        }
+
+        bool contains(int val) {
+            std::lock_guard<std::mutex> guard(lock);
+            return set->contains(val);
+        }
+};
+
+/**
+ * Runs a workload for cuckoo transactional
+ */
+void do_work_transactional(CuckooTransactionalHashSet<int> *cuckoo_transactional, const OpSlice ops, std::vector<Metrics> *transactional_metrics) {
+    do_work_concurrent(cuckoo_transactional, ops, transactional_metrics);
+}
+
+/**
+ * Gives a cuckoo filter the workload the way a filter is used: a key is only
+ * added while absent and only removed while present, since the filter
+ * stores a fingerprint per add and cannot tell a duplicate. Each key's state
+ * is claimed with a CAS before the filter is touched, so no two threads
+ * write the same key at once. A write whose key is in flight on another
+ * thread counts as a miss.
+ */
+template <class Filter>
+class FilterWorkloadAdapter {
+    enum KeyState : uint8_t { ABSENT, PRESENT, BUSY };
+
+    Filter *filter;
+    std::vector<std::atomic<uint8_t>> states;
+
+    public:
+        std::atomic<long> failed_adds{0};
+
+        FilterWorkloadAdapter(Filter *filter, int key_max) : filter(filter), states(key_max + 1) {}
+
+        bool populate(const std::vector<int> &entries) {
+            for (int entry : entries)
+                states[entry] = PRESENT;
+            return filter->populate(entries);
+        }
+
+        bool add(int val) {
+            uint8_t expected = ABSENT;
+            if (!states[val].compare_exchange_strong(expected, BUSY))
+                return false;
+            bool added = filter->add(val);
+            if (!added)
+                failed_adds++;
+            states[val].store(added ? PRESENT : ABSENT, std::memory_order_release);
+            return added;
+        }
+
+        bool remove(int val) {
+            uint8_t expected = PRESENT;
+            if (!states[val].compare_exchange_strong(expected, BUSY))
+                return false;
+            bool removed = filter->remove(val);
+            states[val].store(ABSENT, std::memory_order_release);
+            return removed;
+        }
+
+        bool contains(int val) {
+            return filter->contains(val);
+        }
+};
+
+/**
+ * Runs the concurrent workload against a cuckoo filter, then measures the
+ * false positive rate with keys that were never inserted
+ */
+int run_filter() {
+    std::cout << "Starting cuckoo filter..." << std::endl;
+    CuckooFilter<int> *cuckoo_filter = new CuckooFilter<int>(CAPACITY, FILTER_FPR);
+    FilterWorkloadAdapter<CuckooFilter<int>> filter_workload(cuckoo_filter, KEY_MAX);
+    Workload workload;
+    if (!generate_workload(workload, NUM_THREADS, NUM_OPS) || !filter_workload.populate(workload.initial_entries())) {
+        std::cerr << "Filter setup failed" << std::endl;
+        delete cuckoo_filter;
+        return 1;
+    }
+    std::vector<std::thread> filter_threads;
+    filter_threads.reserve(NUM_THREADS);
+    std::vector<Metrics> filter_metrics;
+    filter_metrics.reserve(NUM_THREADS);
+    for (int thread = 0; thread < NUM_THREADS; thread++) {
+        filter_threads.push_back(std::thread([&, thread](){do_work_concurrent(&filter_workload, workload.stream(thread), &filter_metrics);}));
+    }
+    for (int thread = 0; thread < NUM_THREADS; thread++) {
+        filter_threads[thread].join();
+    }
+    Metrics total_filter_metrics = {};
+    for (auto metrics : filter_metrics) {
+        double exec_time = (double) metrics.exec_time / (double) 1000000;
+        total_filter_metrics.exec_time += exec_time / NUM_THREADS;
+        total_filter_metrics.contains_hit += metrics.contains_hit;
+        total_filter_metrics.contains_miss += metrics.contains_miss;
+        total_filter_metrics.add_hit += metrics.add_hit;
+        total_filter_metrics.add_miss += metrics.add_miss;
+        total_filter_metrics.remove_hit += metrics.remove_hit;
+        total_filter_metrics.remove_miss += metrics.remove_miss;
+    }
+
+    // Keys above KEY_MAX are never generated, so every hit is a false positive
+    int false_positives = 0;
+    for (int probe = 1; probe <= FILTER_PROBES; probe++) {
+        if (cuckoo_filter->contains(KEY_MAX + probe))
+            false_positives++;
+    }
+    std::cout << "Average filter exec_time (milliseconds):\t\t" << total_filter_metrics.exec_time << std::endl;
+    std::cout << std::fixed << "Average filter total throughput (ops/sec):\t\t" << (double) (NUM_OPS * NUM_THREADS) / (total_filter_metrics.exec_time / 1000.0) << std::endl;
+    std::cout << "Filter total contains hit: " << total_filter_metrics.contains_hit << std::endl;
+    std::cout << "Filter total contains miss: " << total_filter_metrics.contains_miss << std::endl;
+    std::cout << "Filter total add hit: " << total_filter_metrics.add_hit << std::endl;
+    std::cout << "Filter total add miss: " << total_filter_metrics.add_miss << std::endl;
+    std::cout << "Filter failed adds (filter full): " << filter_workload.failed_adds << std::endl;
+    std::cout << "Filter total remove hit: " << total_filter_metrics.remove_hit << std::endl;
+    std::cout << "Filter total remove miss: " << total_filter_metrics.remove_miss << std::endl;
+    std::cout << "Filter fingerprints: " << cuckoo_filter->size() << std::endl;
+    std::cout << "Filter fingerprint bits: " << cuckoo_filter->fingerprint_size() << std::endl;
+    std::cout << "Filter bits per key: " << cuckoo_filter->bits_per_key() << std::endl;
+    std::cout << "Filter expected false positive rate: " << cuckoo_filter->expected_fpr() << std::endl;
+    std::cout << "Filter measured false positive rate: " << (double) false_positives / FILTER_PROBES << std::endl;
+    delete cuckoo_filter;
+    return 0;
+}
+
+/**
+ * Runs one concurrent workload and returns the total throughput in ops/sec,
+ * or 0 if the workload could not be set up
+ */
+template <class Set>
+double measure_throughput(int num_threads, int write_pct) {
+    Workload workload;
+    if (!generate_workload(workload, num_threads, COMPARE_OPS, write_pct))
+        return 0;
+    Set *set = new Set(CAPACITY);
+    if (!set->populate(workload.initial_entries())) {
+        std::cerr << "populate failed, skipping " << num_threads << " threads at " << write_pct << "% writes" << std::endl;
+        delete set;
+        return 0;
+    }
+    std::vector<std::thread> threads;
+    std::vector<Metrics> metrics;
+    metrics.reserve(num_threads);
+    for (int thread = 0; thread < num_threads; thread++) {
+        threads.push_back(std::thread([&, thread](){do_work_concurrent(set, workload.stream(thread), &metrics);}));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    Metrics total = {};
+    for (auto m : metrics) {
+        total.exec_time += m.exec_time / num_threads;
+        total.add_hit += m.add_hit;
+        total.remove_hit += m.remove_hit;
+    }
+    int expected_size = INITIAL_SIZE + total.add_hit - total.remove_hit;
+    if (expected_size != set->size())
+        std::cerr << "Size mismatch: expected " << expected_size << ", got " << set->size() << std::endl;
+    delete set;
+    return (double) COMPARE_OPS * num_threads / ((double) total.exec_time / 1000000000.0);
+}
+
+/**
+ * Compares lock striping against flat combining across thread counts and
+ * write ratios
+ */
+int run_flat_combining() {
+    std::cout << "write%\tthreads\tstriped (ops/sec)\tflat combining (ops/sec)\tratio" << std::endl;
+    for (int write_pct : COMPARE_WRITE_PCT) {
+        for (int num_threads : COMPARE_THREADS) {
+            double striped = measure_throughput<CuckooConcurrentHashSet<int>>(num_threads, write_pct);
+            double combining = measure_throughput<CuckooFlatCombiningHashSet<int>>(num_threads, write_pct);
+            if (striped == 0 || combining == 0)
+                continue;
+            std::cout << std::fixed << write_pct << "\t" << num_threads << "\t" << striped << "\t\t"
+                      << combining << "\t\t" << combining / striped << std::endl;
+        }
+    }
+    return 0;
+}
+
+struct CacheMetrics {
+    long long exec_time = 0;
+    long hits = 0;
+    long misses = 0;
+};
+
+/**
+ * Generates a Zipf-distributed lookup stream over CACHE_KEYS keys
+ */
+std::vector<int> generate_cache_keys(int num_ops) {
+    auto seed = std::chrono::high_resolution_clock::now()
+            .time_since_epoch()
+            .count();
+    static thread_local std::mt19937 generator(seed);
+    std::vector<double> weights;
+    weights.reserve(CACHE_KEYS);
+    for (int rank = 1; rank <= CACHE_KEYS; rank++) {
+        weights.push_back(1.0 / pow(rank, CACHE_SKEW));
+    }
+    std::discrete_distribution<int> distribution(weights.begin(), weights.end());
+    std::vector<int> keys;
+    keys.reserve(num_ops);
+    for (int i = 0; i < num_ops; i++) {
+        keys.push_back(distribution(generator));
+    }
+    return keys;
+}
+
+/**
+ * Runs a read-through cache workload: a lookup that misses adds the key,
+ * evicting another once the table is full
+ */
+template <class Set>
+void do_work_cache(Set *cache, std::vector<int> *keys, CacheMetrics &metrics) {
     long long exec_time_start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    for (auto op : ops) {
-        //std::cout << "val: " << op.val << ", type: " << op.type << std::endl;
-        switch (op.type) {
-            // Contains
-            case 0:
-                if (cuckoo_concurrent->contains(op.val))
-                    metrics.contains_hit++;
-                else
-                    metrics.contains_miss++;
-                break;
-            // Insert
-            case 1:
-                if (cuckoo_concurrent->add(op.val))
-                    metrics.add_hit++;
-                else
-                    metrics.add_miss++;
-                break;
-            // Remove
-            default:
-                if (cuckoo_concurrent->remove(op.val))
-                    metrics.remove_hit++;
-                else
-                    metrics.remove_miss++;
-                break;
+    for (int key : *keys) {
+        if (cache->contains(key)) {
+            metrics.hits++;
+        } else {
+            metrics.misses++;
+            cache->add(key);
         }
     }
     long long exec_time_end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-	metrics.exec_time = exec_time_end - exec_time_start;
+    metrics.exec_time = exec_time_end - exec_time_start;
+}
 
-    std::mutex lock();
-    concurrent_metrics->push_back(metrics);
-    std::mutex unlock();
+void print_cache_metrics(const char *name, CacheMetrics &metrics, long evictions, int size, int num_threads) {
+    double seconds = (double) metrics.exec_time / 1000000000.0;
+    std::cout << std::fixed << name << " hit ratio: " << (double) metrics.hits / (metrics.hits + metrics.misses) << std::endl;
+    std::cout << name << " throughput (ops/sec): " << (double) CACHE_OPS * num_threads / seconds << std::endl;
+    std::cout << name << " evictions: " << evictions << std::endl;
+    std::cout << name << " size: " << size << std::endl << std::endl;
 }
 
 /**
- * Runs a workload for cuckoo transactional
+ * Compares CLOCK against plain eviction in the serial and concurrent engines
+ * used as fixed-size caches
  */
-void do_work_transactional(CuckooTransactionalHashSet<int> *cuckoo_transactional, std::vector<int> transactional_entries, std::vector<Metrics> *transactional_metrics) {
-    Metrics metrics = {};
-    auto ops = generate_operations(NUM_OPS, &transactional_entries);
-    // Start doing work
-    long long exec_time_start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    for (auto op : ops) {
-        //std::cout << "val: " << op.val << ", type: " << op.type << std::endl;
-        switch (op.type) {
-            // Contains
-            case 0:
-                if (cuckoo_transactional->contains(op.val))
-                    metrics.contains_hit++;
-                else
-                    metrics.contains_miss++;
+int run_cache() {
+    const FullPolicy policies[] = {FullPolicy::Evict, FullPolicy::EvictClock};
+    const char *serial_names[] = {"Serial evict", "Serial clock"};
+    const char *concurrent_names[] = {"Concurrent evict", "Concurrent clock"};
+    for (int p = 0; p < 2; p++) {
+        // Two slots per bucket index in the serial table
+        CuckooSerialHashSet<int> *serial_cache = new CuckooSerialHashSet<int>(CACHE_CAPACITY / 2, policies[p]);
+        auto keys = generate_cache_keys(CACHE_OPS * NUM_THREADS);
+        CacheMetrics serial_metrics;
+        do_work_cache(serial_cache, &keys, serial_metrics);
+        print_cache_metrics(serial_names[p], serial_metrics, serial_cache->evictions(), serial_cache->size(), NUM_THREADS);
+        delete serial_cache;
+
+        // Probe sets hold up to 8 entries, two sets per bucket index
+        CuckooConcurrentHashSet<int> *concurrent_cache = new CuckooConcurrentHashSet<int>(CACHE_CAPACITY / 16, policies[p]);
+        std::vector<std::vector<int>> thread_keys(NUM_THREADS);
+        std::vector<CacheMetrics> thread_metrics(NUM_THREADS);
+        for (int thread = 0; thread < NUM_THREADS; thread++) {
+            thread_keys[thread] = generate_cache_keys(CACHE_OPS);
+        }
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < NUM_THREADS; thread++) {
+            threads.push_back(std::thread([&, thread](){do_work_cache(concurrent_cache, &thread_keys[thread], thread_metrics[thread]);}));
+        }
+        CacheMetrics concurrent_metrics;
+        for (int thread = 0; thread < NUM_THREADS; thread++) {
+            threads[thread].join();
+            concurrent_metrics.hits += thread_metrics[thread].hits;
+            concurrent_metrics.misses += thread_metrics[thread].misses;
+            concurrent_metrics.exec_time += thread_metrics[thread].exec_time / NUM_THREADS;
+        }
+        print_cache_metrics(concurrent_names[p], concurrent_metrics, concurrent_cache->evictions(), concurrent_cache->size(), NUM_THREADS);
+        delete concurrent_cache;
+    }
+    return 0;
+}
+
+/**
+ * Registers the calling thread with sets that need it before their first
+ * operation, see CuckooAdaptiveHashSet::attach. A no-op for the others.
+ */
+template <class Set>
+inline void attach_worker(Set *) {}
+
+template <class T>
+inline void attach_worker(CuckooAdaptiveHashSet<T> *set) {
+    set->attach();
+}
+
+template <class Set>
+inline void detach_worker(Set *) {}
+
+template <class T>
+inline void detach_worker(CuckooAdaptiveHashSet<T> *set) {
+    set->detach();
+}
+
+/**
+ * return: how often set grew with writers blocked, 0 for sets whose resize
+ * does not block them all
+ */
+template <class Set>
+inline int blocking_resizes(Set *) {
+    return 0;
+}
+
+template <class T>
+inline int blocking_resizes(CuckooLockFreeHashSet<T> *set) {
+    return set->resizes();
+}
+
+/**
+ * Runs one point of the sweep: num_threads pinned workers released together
+ * by a barrier, timed from the release until the last worker finishes. The
+ * driver thread attaches too, so an adaptive set stays shared even with one
+ * worker. capacity sizes the set.
+ * return: total throughput in ops/sec, or 0 if the workload could not be set
+ * up
+ */
+template <class Set>
+double run_sweep_point(int num_threads, const std::vector<int> &cpus, int capacity) {
+    Workload workload;
+    if (!generate_workload(workload, num_threads, SWEEP_OPS))
+        return 0;
+    Set *set = new Set(capacity);
+    if (!set->populate(workload.initial_entries())) {
+        std::cerr << "populate failed, skipping " << num_threads << " threads" << std::endl;
+        delete set;
+        return 0;
+    }
+    attach_worker(set);
+    StartBarrier barrier;
+    std::vector<Metrics> metrics(num_threads);
+    std::vector<long long> end_times(num_threads);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < num_threads; thread++) {
+        threads.push_back(std::thread([&, thread]() {
+            if (!cpus.empty())
+                pin_to_cpu(cpus[thread % cpus.size()]);
+            attach_worker(set);
+            barrier.arrive_and_wait();
+            run_operations(set, workload.stream(thread), metrics[thread]);
+            end_times[thread] = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+            detach_worker(set);
+        }));
+    }
+    barrier.wait_for(num_threads);
+    long long start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    barrier.release();
+    for (auto &thread : threads)
+        thread.join();
+    long long end = *std::max_element(end_times.begin(), end_times.end());
+
+    int expected_size = INITIAL_SIZE;
+    for (auto &m : metrics)
+        expected_size += m.add_hit - m.remove_hit;
+    if (expected_size != set->size())
+        std::cerr << "Size mismatch: expected " << expected_size << ", got " << set->size() << std::endl;
+    if (blocking_resizes(set) > 0)
+        std::cerr << "Resized " << blocking_resizes(set) << " times with writers blocked at " << num_threads
+                  << " threads, raise the capacity" << std::endl;
+    detach_worker(set);
+    delete set;
+    return (double) SWEEP_OPS * num_threads / ((double) (end - start) / 1000000000.0);
+}
+
+template <class Set>
+void run_sweep_impl(const char *name, const std::vector<int> &thread_counts, const std::vector<int> &cpus) {
+    double base = 0;
+    for (int num_threads : thread_counts) {
+        double throughput = run_sweep_point<Set>(num_threads, cpus, SWEEP_CAPACITY);
+        if (throughput == 0)
+            continue;
+        if (base == 0)
+            base = throughput / num_threads;
+        std::cout << std::fixed << std::setprecision(0) << name << "\t" << num_threads << "\t" << throughput
+                  << "\t" << std::setprecision(3) << throughput / base << std::endl;
+    }
+}
+
+/**
+ * Measures each thread-safe implementation at increasing thread counts
+ * Options: -t 1,2,4 (thread counts, default powers of two up to the core
+ * count), -p none|compact|scatter|smt (pinning policy, default compact)
+ */
+int run_sweep() {
+    std::vector<int> thread_counts = options.thread_counts;
+    PinPolicy policy = options.pin_policy;
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    if (thread_counts.empty()) {
+        for (int count = 1; count < cores; count *= 2)
+            thread_counts.push_back(count);
+        thread_counts.push_back(cores);
+    }
+    std::vector<int> cpus;
+    if (policy != PinPolicy::None)
+        cpus = cpu_order(policy);
+
+    // Speedup is relative to the first point's per-thread throughput
+    std::cout << "impl\tthreads\tops_per_sec\tspeedup" << std::endl;
+    run_sweep_impl<CuckooConcurrentHashSet<int>>("concurrent", thread_counts, cpus);
+    run_sweep_impl<CuckooAdaptiveHashSet<int>>("adaptive/shared", thread_counts, cpus);
+    run_sweep_impl<CuckooLockFreeHashSet<int>>("lockfree", thread_counts, cpus);
+    run_sweep_impl<CuckooFlatCombiningHashSet<int>>("flat_combining", thread_counts, cpus);
+    run_sweep_impl<LockedUnorderedSet<int>>("locked_unordered", thread_counts, cpus);
+    return 0;
+}
+
+/**
+ * Runs the sweep past the core count with unpinned workers, so the scheduler
+ * preempts them mid-operation: a preempted lock holder stalls every thread
+ * waiting on its lock, a preempted lock-free writer stalls no one. Growing
+ * the lock-free set is the exception, so the sets are pre-sized.
+ * Options: -t 8,16,... (thread counts, default 1, 2, 4 and 8 threads per
+ * core)
+ */
+int run_oversubscribed() {
+    std::vector<int> thread_counts = options.thread_counts;
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    if (thread_counts.empty()) {
+        for (int per_core = 1; per_core <= OVERSUB_PER_CORE; per_core *= 2)
+            thread_counts.push_back(cores * per_core);
+    }
+    std::vector<int> cpus;
+
+    std::cout << "cores: " << cores << std::endl;
+    std::cout << "lockfree resize blocks every writer until it ends; capacity " << SWEEP_CAPACITY
+              << " for at most " << KEY_MAX << " keys keeps it from happening here" << std::endl;
+    std::cout << "impl\tthreads\tops_per_sec\tspeedup" << std::endl;
+    run_sweep_impl<CuckooLockFreeHashSet<int>>("lockfree", thread_counts, cpus);
+    run_sweep_impl<CuckooConcurrentHashSet<int>>("concurrent", thread_counts, cpus);
+    run_sweep_impl<CuckooFlatCombiningHashSet<int>>("flat_combining", thread_counts, cpus);
+    run_sweep_impl<LockedUnorderedSet<int>>("locked_unordered", thread_counts, cpus);
+    return 0;
+}
+
+/**
+ * Issues one write the way the set under test takes it: synchronously, or
+ * queued for an applier
+ */
+inline void issue_write(CuckooConcurrentHashSet<int> *set, bool add, int val) {
+    if (add)
+        set->add(val);
+    else
+        set->remove(val);
+}
+
+inline void issue_write(CuckooAsyncHashSet<int> *set, bool add, int val) {
+    if (add)
+        set->add_async(val);
+    else
+        set->remove_async(val);
+}
+
+/**
+ * Runs the workload on num_threads producers, timing every add and remove
+ * from the producer's side
+ * latencies: filled with each write's latency in ns
+ * return: producer throughput in ops/sec
+ */
+template <class Set>
+double measure_write_latency(Set *set, int num_threads, std::vector<long> &latencies) {
+    Workload workload;
+    if (!generate_workload(workload, num_threads, ASYNC_OPS))
+        return 0;
+    if (!set->populate(workload.initial_entries()))
+        return 0;
+    std::vector<std::vector<long>> thread_latencies(num_threads);
+    std::vector<std::thread> threads;
+    long long start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    for (int thread = 0; thread < num_threads; thread++) {
+        threads.push_back(std::thread([&, thread]() {
+            std::vector<long> &mine = thread_latencies[thread];
+            mine.reserve(ASYNC_OPS);
+            for (uint32_t op : workload.stream(thread)) {
+                int val = op_key(op);
+                if (op_type(op) == OP_CONTAINS) {
+                    set->contains(val);
+                    continue;
+                }
+                auto op_start = std::chrono::steady_clock::now();
+                issue_write(set, op_type(op) == OP_ADD, val);
+                mine.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - op_start).count());
+            }
+        }));
+    }
+    for (auto &thread : threads)
+        thread.join();
+    long long end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    for (auto &mine : thread_latencies)
+        latencies.insert(latencies.end(), mine.begin(), mine.end());
+    return (double) ASYNC_OPS * num_threads / ((double) (end - start) / 1000000000.0);
+}
+
+/**
+ * return: the p quantile of sorted, 0 if it is empty
+ */
+long percentile(const std::vector<long> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+}
+
+void print_latency_row(const char *name, int num_threads, double throughput, std::vector<long> &latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << std::fixed << std::setprecision(0) << name << "\t" << num_threads << "\t" << throughput
+              << "\t" << percentile(latencies, 0.5) << "\t" << percentile(latencies, 0.9)
+              << "\t" << percentile(latencies, 0.99) << "\t" << percentile(latencies, 0.999)
+              << "\t" << percentile(latencies, 1.0) << std::endl;
+}
+
+/**
+ * Compares producer-side write latency of synchronous adds and removes on
+ * the striped set against write-behind queueing, then times the drain
+ * Options: -t 1,2,4 (producer counts, default NUM_THREADS)
+ */
+int run_async() {
+    std::vector<int> thread_counts = options.thread_counts;
+    if (thread_counts.empty())
+        thread_counts.push_back(NUM_THREADS);
+    std::cout << "impl\tthreads\tops_per_sec\tp50_ns\tp90_ns\tp99_ns\tp99.9_ns\tmax_ns" << std::endl;
+    for (int num_threads : thread_counts) {
+        std::vector<long> latencies;
+        CuckooConcurrentHashSet<int> *sync = new CuckooConcurrentHashSet<int>(CAPACITY);
+        double throughput = measure_write_latency(sync, num_threads, latencies);
+        print_latency_row("sync", num_threads, throughput, latencies);
+        delete sync;
+
+        latencies.clear();
+        CuckooAsyncHashSet<int> *async = new CuckooAsyncHashSet<int>(CAPACITY, ASYNC_APPLIERS);
+        throughput = measure_write_latency(async, num_threads, latencies);
+        print_latency_row("async", num_threads, throughput, latencies);
+        auto flush_start = std::chrono::steady_clock::now();
+        async->flush();
+        double flush_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - flush_start).count();
+        std::cout << "  flush (us): " << flush_us << ", backpressure waits: " << async->backpressure_waits()
+                  << ", no-op writes: " << async->failed_writes() << ", size: " << async->size() << std::endl;
+        delete async;
+    }
+    return 0;
+}
+
+/**
+ * Runs num_ops ops of each stream open-loop: every thread schedules its ops
+ * at rate ops/sec, evenly spaced or with Poisson arrivals, and issues each
+ * at its scheduled time or, when running behind, as soon as it can. Latency
+ * is taken from the scheduled time, so time spent behind schedule (stuck
+ * behind a resize, say) counts against every op it delayed.
+ * latencies: filled with every op's latency in ns
+ * return: the achieved throughput in ops/sec
+ */
+template <class Set>
+double run_open_loop_point(Set *set, Workload &workload, int num_threads, int num_ops, double rate,
+                           std::vector<long> &latencies) {
+    typedef std::chrono::steady_clock Clock;
+    std::vector<std::vector<long>> thread_latencies(num_threads);
+    std::vector<Clock::time_point> end_times(num_threads);
+    StartBarrier barrier;
+    Clock::time_point start;
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < num_threads; thread++) {
+        threads.push_back(std::thread([&, thread]() {
+            std::mt19937_64 generator(options.seed + thread);
+            std::exponential_distribution<double> gap(rate);
+            std::vector<long> &mine = thread_latencies[thread];
+            mine.reserve(num_ops);
+            Metrics metrics;
+            OpSlice ops = workload.stream(thread);
+            barrier.arrive_and_wait();
+            double offset = 0;
+            for (int i = 0; i < num_ops; i++) {
+                offset += options.poisson ? gap(generator) : 1.0 / rate;
+                Clock::time_point intended = start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(offset));
+                while (Clock::now() < intended)
+                    std::this_thread::yield();
+                run_operations(set, OpSlice{ops.begin() + i, 1}, metrics);
+                mine.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - intended).count());
+            }
+            end_times[thread] = Clock::now();
+        }));
+    }
+    barrier.wait_for(num_threads);
+    start = Clock::now();
+    barrier.release();
+    for (auto &thread : threads)
+        thread.join();
+    Clock::time_point end = *std::max_element(end_times.begin(), end_times.end());
+    for (auto &mine : thread_latencies)
+        latencies.insert(latencies.end(), mine.begin(), mine.end());
+    return (double) num_ops * num_threads / std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * One throughput-vs-latency curve: a fresh, populated set per offered load
+ */
+template <class Set>
+void run_open_loop_curve(const char *name, Workload &workload, int num_threads, const std::vector<double> &loads) {
+    for (double load : loads) {
+        int num_ops = std::min((double) workload.ops_per_stream(), load / num_threads * OPEN_LOOP_SECONDS);
+        Set *set = new Set(CAPACITY);
+        if (!set->populate(workload.initial_entries())) {
+            std::cerr << name << ": populate failed, skipping offered load " << std::fixed << std::setprecision(0) << load << std::endl;
+            delete set;
+            continue;
+        }
+        std::vector<long> latencies;
+        double achieved = run_open_loop_point(set, workload, num_threads, std::max(1, num_ops),
+                                              load / num_threads, latencies);
+        delete set;
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::fixed << std::setprecision(0) << name << "\t" << load << "\t" << achieved
+                  << "\t" << percentile(latencies, 0.5) << "\t" << percentile(latencies, 0.99)
+                  << "\t" << percentile(latencies, 0.999) << "\t" << percentile(latencies, 1.0) << std::endl;
+    }
+}
+
+/**
+ * Sweeps the offered load for each thread-safe implementation, reporting
+ * achieved throughput and latency measured from each op's scheduled start
+ * Options: -L 100000,200000 (offered loads, total ops/sec), -a poisson|const
+ * (arrivals, default poisson), -t 8 (threads, first count used, default
+ * NUM_THREADS)
+ */
+int run_open_loop() {
+    int num_threads = options.thread_counts.empty() ? NUM_THREADS : options.thread_counts[0];
+    std::vector<double> loads = options.offered_loads;
+    if (loads.empty())
+        loads.assign(std::begin(OPEN_LOOP_LOADS), std::end(OPEN_LOOP_LOADS));
+    double max_load = *std::max_element(loads.begin(), loads.end());
+    int ops_per_thread = std::min((double) OPEN_LOOP_OPS, max_load / num_threads * OPEN_LOOP_SECONDS);
+    Workload workload;
+    if (!generate_workload(workload, num_threads, std::max(1, ops_per_thread)))
+        return 1;
+
+    std::cout << num_threads << " threads, " << (options.poisson ? "poisson" : "constant") << " arrivals" << std::endl;
+    std::cout << "impl\toffered_ops_per_sec\tachieved_ops_per_sec\tp50_ns\tp99_ns\tp99.9_ns\tmax_ns" << std::endl;
+    run_open_loop_curve<CuckooConcurrentHashSet<int>>("concurrent", workload, num_threads, loads);
+    run_open_loop_curve<GlobalLockAdapter<CuckooTransactionalHashSet<int>>>("transactional", workload, num_threads, loads);
+    run_open_loop_curve<CuckooFlatCombiningHashSet<int>>("flat_combining", workload, num_threads, loads);
+    run_open_loop_curve<LockedUnorderedSet<int>>("locked_unordered", workload, num_threads, loads);
+    return 0;
+}
+
+/**
+ * Runs one process per stream against a CuckooSharedHashSet: the parent
+ * creates and populates the segment, then forks workers that attach to it
+ * by name. Results come back through an anonymous shared mapping: the
+ * start barrier, then one Metrics per worker.
+ * return: total throughput in ops/sec
+ */
+double run_shared_point(Workload &workload, int num_processes) {
+    size_t metrics_offset = (sizeof(StartBarrier) + alignof(Metrics) - 1) / alignof(Metrics) * alignof(Metrics);
+    size_t shared_size = metrics_offset + num_processes * sizeof(Metrics);
+    void *mapping = mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+    StartBarrier *barrier = new (mapping) StartBarrier();
+    Metrics *metrics = reinterpret_cast<Metrics*>(static_cast<char*>(mapping) + metrics_offset);
+    for (int process = 0; process < num_processes; process++)
+        new (&metrics[process]) Metrics();
+
+    CuckooSharedHashSet<int>::unlink(SHM_NAME);
+    CuckooSharedHashSet<int> set;
+    if (!set.create(SHM_NAME, CAPACITY) || !set.populate(workload.initial_entries())) {
+        munmap(mapping, shared_size);
+        return 0;
+    }
+    std::cout.flush();
+    std::vector<pid_t> children;
+    for (int process = 0; process < num_processes; process++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            CuckooSharedHashSet<int> attached;
+            bool ok = attached.attach(SHM_NAME);
+            // Arrive even on failure, the parent waits for every worker
+            barrier->arrive_and_wait();
+            if (!ok)
+                _exit(1);
+            run_operations(&attached, workload.stream(process), metrics[process]);
+            _exit(0);
+        }
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        children.push_back(pid);
+    }
+    barrier->wait_for(children.size());
+    long long start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    barrier->release();
+    bool ok = (int) children.size() == num_processes;
+    for (pid_t pid : children) {
+        int status;
+        waitpid(pid, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    long long end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+    int expected_size = INITIAL_SIZE;
+    for (int process = 0; process < num_processes; process++)
+        expected_size += metrics[process].add_hit - metrics[process].remove_hit;
+    if (!ok)
+        std::cerr << "A worker process failed" << std::endl;
+    else if (expected_size != set.size())
+        std::cerr << "Size mismatch: expected " << expected_size << ", got " << set.size() << std::endl;
+    CuckooSharedHashSet<int>::unlink(SHM_NAME);
+    munmap(mapping, shared_size);
+    if (!ok)
+        return 0;
+    return (double) SHM_OPS * num_processes / ((double) (end - start) / 1000000000.0);
+}
+
+/**
+ * Measures the process-shared set with increasing numbers of worker
+ * processes attached to one segment, next to the threads of one process on
+ * CuckooConcurrentHashSet
+ * Options: -t 1,2,4 (process counts, default powers of two up to
+ * NUM_THREADS)
+ */
+int run_shared() {
+    std::vector<int> counts = options.thread_counts;
+    if (counts.empty()) {
+        for (int count = 1; count <= NUM_THREADS; count *= 2)
+            counts.push_back(count);
+    }
+    int max_count = *std::max_element(counts.begin(), counts.end());
+    Workload workload;
+    if (!generate_workload(workload, max_count, SHM_OPS))
+        return 1;
+
+    CuckooSharedHashSet<int>::unlink(SHM_NAME);
+    CuckooSharedHashSet<int> probe;
+    if (!probe.create(SHM_NAME, CAPACITY))
+        return 1;
+    std::cout << "segment: " << probe.segment_bytes() / 1024 << " KiB, shared by every process" << std::endl;
+    CuckooSharedHashSet<int>::unlink(SHM_NAME);
+
+    std::cout << "workers\tshm_processes (ops/sec)\tconcurrent_threads (ops/sec)" << std::endl;
+    for (int count : counts) {
+        double processes = run_shared_point(workload, count);
+        double threads = run_sweep_point<CuckooConcurrentHashSet<int>>(count, std::vector<int>(), CAPACITY);
+        if (processes == 0 || threads == 0)
+            continue;
+        std::cout << std::fixed << std::setprecision(0) << count << "\t" << processes << "\t\t\t" << threads << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * Passes operations through to a set and keeps the net count of successful
+ * adds and removes per key, so the final contents can be checked
+ */
+template <class Set>
+class LedgerAdapter {
+    Set *set;
+
+    public:
+        std::vector<int> delta;
+
+        LedgerAdapter(Set *set, int key_max) : set(set), delta(key_max + 1) {}
+
+        bool add(int val) {
+            bool added = set->add(val);
+            delta[val] += added;
+            return added;
+        }
+
+        bool remove(int val) {
+            bool removed = set->remove(val);
+            delta[val] -= removed;
+            return removed;
+        }
+
+        bool contains(int val) {
+            return set->contains(val);
+        }
+};
+
+/**
+ * Exercises CuckooAdaptiveHashSet's switch between solo and shared mode: one
+ * steady worker stays attached for its whole stream while helpers attach,
+ * run a burst of HANDOFF_BURST ops and detach again, pausing in between so
+ * the steady worker keeps going back to running unlocked. The size and
+ * every key's membership are checked against the successful adds and
+ * removes afterwards.
+ * Options: -t 3 (helper threads, first count used, default HANDOFF_HELPERS)
+ */
+int run_handoff() {
+    int helpers = options.thread_counts.empty() ? HANDOFF_HELPERS : options.thread_counts[0];
+    int num_threads = helpers + 1;
+    Workload workload;
+    if (!generate_workload(workload, num_threads, HANDOFF_OPS))
+        return 1;
+    CuckooAdaptiveHashSet<int> set(CAPACITY);
+    if (!set.populate(workload.initial_entries()))
+        return 1;
+
+    typedef LedgerAdapter<CuckooAdaptiveHashSet<int>> Ledger;
+    std::vector<Ledger> ledgers(num_threads, Ledger(&set, KEY_MAX));
+    std::vector<Metrics> metrics(num_threads);
+    std::atomic<long> attachments(0);
+    std::atomic<bool> steady_done(false);
+    long solo_bursts = 0, shared_bursts = 0;
+    auto burst = [&](const OpSlice &ops, size_t offset) {
+        OpSlice slice;
+        slice.ops = ops.ops + offset;
+        slice.count = std::min((size_t) HANDOFF_BURST, ops.count - offset);
+        return slice;
+    };
+
+    long long start = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread([&]() {
+        OpSlice ops = workload.stream(0);
+        set.attach();
+        for (size_t offset = 0; offset < ops.count; offset += HANDOFF_BURST) {
+            // Sampled, the mode can change during the burst
+            if (set.solo())
+                solo_bursts++;
+            else
+                shared_bursts++;
+            run_operations(&ledgers[0], burst(ops, offset), metrics[0]);
+        }
+        set.detach();
+        steady_done = true;
+    }));
+    for (int thread = 1; thread < num_threads; thread++) {
+        threads.push_back(std::thread([&, thread]() {
+            OpSlice ops = workload.stream(thread);
+            for (size_t offset = 0; offset < ops.count; offset += HANDOFF_BURST) {
+                set.attach();
+                attachments++;
+                run_operations(&ledgers[thread], burst(ops, offset), metrics[thread]);
+                set.detach();
+                // Past the steady worker's end there is no one to hand off to
+                if (!steady_done)
+                    std::this_thread::sleep_for(std::chrono::microseconds(HANDOFF_PAUSE_US));
+            }
+        }));
+    }
+    for (auto &thread : threads)
+        thread.join();
+    long long end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+    std::cout << "1 steady worker, " << helpers << " helpers attaching for " << HANDOFF_BURST << " ops at a time" << std::endl;
+    std::cout << "attachments: " << attachments << ", steady worker bursts started solo: " << solo_bursts
+              << ", shared: " << shared_bursts << std::endl;
+    std::cout << std::fixed << std::setprecision(0) << "throughput (ops/sec): "
+              << (double) HANDOFF_OPS * num_threads / ((double) (end - start) / 1000000000.0) << std::endl;
+
+    bool ok = true;
+    int expected_size = INITIAL_SIZE;
+    for (auto &m : metrics)
+        expected_size += m.add_hit - m.remove_hit;
+    if (expected_size != set.size()) {
+        std::cerr << "Size mismatch: expected " << expected_size << ", got " << set.size() << std::endl;
+        ok = false;
+    }
+    std::vector<int> expected(KEY_MAX + 1);
+    for (int entry : workload.initial_entries())
+        expected[entry]++;
+    int wrong = 0;
+    for (int key = 0; key <= KEY_MAX; key++) {
+        for (auto &ledger : ledgers)
+            expected[key] += ledger.delta[key];
+        // Successful adds and removes of a key alternate, whatever thread
+        // made them
+        if (expected[key] < 0 || expected[key] > 1 || set.contains(key) != (expected[key] == 1))
+            wrong++;
+    }
+    if (wrong > 0) {
+        std::cerr << "Contents mismatch: " << wrong << " keys differ from their adds and removes" << std::endl;
+        ok = false;
+    }
+    std::cout << "size and contents: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+void usage(const char *program) {
+    std::cerr << "Usage: " << program << " [all|filter|fc|cache|sweep|oversub|async|openloop|shm|handoff] [options]" << std::endl
+              << "  -s seed          workload seed (default " << DEFAULT_SEED << ")" << std::endl
+              << "  -w file          save the generated workload to file (all mode only)" << std::endl
+              << "  -r file          map the workload from file instead of generating it (all mode only)" << std::endl
+              << "  -t 1,2,4,...     sweep / oversub / async thread counts, open-loop threads, shm processes," << std::endl
+              << "                   handoff helper threads" << std::endl
+              << "  -p none|compact|scatter|smt  sweep pinning policy" << std::endl
+              << "  -L 1e5,1e6,...   open-loop offered loads (total ops/sec)" << std::endl
+              << "  -a poisson|const open-loop arrivals" << std::endl
+              << "  -P               count cycles, instructions, cache/TLB/branch misses and" << std::endl
+              << "                   context switches per thread, reported per op" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    std::string mode = "all";
+    optind = 1;
+    if (argc > 1 && argv[1][0] != '-') {
+        mode = argv[1];
+        optind = 2;
+    }
+    int opt;
+    while ((opt = getopt(argc, argv, "s:w:r:t:p:PL:a:")) != -1) {
+        switch (opt) {
+            case 's': options.seed = strtoull(optarg, nullptr, 10); break;
+            case 'w': options.workload_out = optarg; break;
+            case 'r': options.workload_in = optarg; break;
+            case 'P': options.perf = true; break;
+            case 't': {
+                std::stringstream list(optarg);
+                std::string count;
+                while (std::getline(list, count, ','))
+                    options.thread_counts.push_back(atoi(count.c_str()));
                 break;
-            // Insert
-            case 1:
-                if (cuckoo_transactional->add(op.val))
-                    metrics.add_hit++;
-                else
-                    metrics.add_miss++;
+            }
+            case 'L': {
+                std::stringstream list(optarg);
+                std::string load;
+                while (std::getline(list, load, ','))
+                    options.offered_loads.push_back(atof(load.c_str()));
                 break;
-            // Remove
+            }
+            case 'a':
+                if (strcmp(optarg, "poisson") == 0 || strcmp(optarg, "const") == 0) {
+                    options.poisson = optarg[0] == 'p';
+                    break;
+                }
+                usage(argv[0]);
+                return 1;
+            case 'p':
+                if (parse_pin_policy(optarg, options.pin_policy))
+                    break;
+                // fall through
             default:
-                if (cuckoo_transactional->remove(op.val))
-                    metrics.remove_hit++;
-                else
-                    metrics.remove_miss++;
-                break;
+                usage(argv[0]);
+                return 1;
         }
     }
-    long long exec_time_end = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-	metrics.exec_time = exec_time_end - exec_time_start;
 
-    std::mutex lock();
-    transactional_metrics->push_back(metrics);
-    std::mutex unlock();
-}
+    // The other modes generate a workload per point measured, one file
+    // cannot stand in for them
+    if (mode != "all" && (options.workload_in != nullptr || options.workload_out != nullptr)) {
+        std::cerr << "-r and -w only apply to the all mode" << std::endl;
+        return 1;
+    }
+
+    if (mode == "filter")
+        return run_filter();
+    if (mode == "fc")
+        return run_flat_combining();
+    if (mode == "cache")
+        return run_cache();
+    if (mode == "sweep")
+        return run_sweep();
+    if (mode == "oversub")
+        return run_oversubscribed();
+    if (mode == "async")
+        return run_async();
+    if (mode == "openloop")
+        return run_open_loop();
+    if (mode == "shm")
+        return run_shared();
+    if (mode == "handoff")
+        return run_handoff();
+    if (mode != "all") {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Generate the workload once; every implementation runs the same one
+    Workload workload;
+    if (options.workload_in != nullptr) {
+        if (!workload.load(options.workload_in))
+            return 1;
+    } else if (!generate_workload(workload, NUM_THREADS, NUM_OPS)) {
+        return 1;
+    }
+    if (options.workload_out != nullptr && !workload.save(options.workload_out))
+        return 1;
+    const int num_threads = workload.num_streams();
+    const long long total_ops = (long long) workload.ops_per_stream() * num_threads;
+    const int initial_size = workload.initial_size();
 
-int main(int argc, char *argv[]) {
     // Serial Cuckoo
     std::cout << "Starting serial cuckoo..." << std::endl;
     CuckooSerialHashSet<int> *cuckoo_serial = new CuckooSerialHashSet<int>(CAPACITY);
-    // Setup hash table and pre-generate workload
+    // Setup hash table and run every stream back to back
     Metrics serial_metrics = {};
-    auto serial_entries = generate_entries(INITIAL_SIZE);
-    if (!cuckoo_serial->populate(serial_entries))
+    if (!cuckoo_serial->populate(workload.initial_entries()))
         return 0;
-    auto serial_ops = generate_operations(NUM_OPS * NUM_THREADS, &serial_entries);
-    do_work_serial(cuckoo_serial, serial_ops, serial_metrics);
-    int serial_expected_size = INITIAL_SIZE + serial_metrics.add_hit - serial_metrics.remove_hit;
+    do_work_serial(cuckoo_serial, workload.all_streams(), serial_metrics);
+    int serial_expected_size = initial_size + serial_metrics.add_hit - serial_metrics.remove_hit;
     assert(serial_expected_size == cuckoo_serial->size());
     std::cout << "Serial time (milliseconds):\t\t" << (double) serial_metrics.exec_time / 1000000.0 << std::endl;
-    std::cout << std::fixed << "Serial average throughput (ops/sec):\t" << (double) (NUM_OPS * NUM_THREADS) / ((double) serial_metrics.exec_time / 1000000000.0) << std::endl;
+    std::cout << std::fixed << "Serial average throughput (ops/sec):\t" << (double) total_ops / ((double) serial_metrics.exec_time / 1000000000.0) << std::endl;
     std::cout << "Serial contains hit: " << serial_metrics.contains_hit << std::endl;
     std::cout << "Serial contains miss: " << serial_metrics.contains_miss << std::endl;
     std::cout << "Serial add hit: " << serial_metrics.add_hit << std::endl;
     std::cout << "Serial add miss: " << serial_metrics.add_miss << std::endl;
     std::cout << "Serial remove hit: " << serial_metrics.remove_hit << std::endl;
-    std::cout << "Serial remove miss: " << serial_metrics.remove_miss << std::endl << std::endl;
+    std::cout << "Serial remove miss: " << serial_metrics.remove_miss << std::endl;
+    print_perf("Serial", serial_metrics.perf, total_ops);
+    std::cout << std::endl;
     delete cuckoo_serial;
 
     // Concurrent Cuckoo
     std::cout << "Starting concurrent cuckoo..." << std::endl;
     CuckooConcurrentHashSet<int> *cuckoo_concurrent = new CuckooConcurrentHashSet<int>(CAPACITY);
-    auto concurrent_entries = generate_entries(INITIAL_SIZE);
-    if (!cuckoo_concurrent->populate(concurrent_entries))
+    if (!cuckoo_concurrent->populate(workload.initial_entries()))
         return 0;
     std::vector<std::thread> concurrent_threads = std::vector<std::thread>();
-	concurrent_threads.reserve(NUM_THREADS);
+	concurrent_threads.reserve(num_threads);
     std::vector<Metrics> concurrent_metrics = std::vector<Metrics>();
-    concurrent_metrics.reserve(NUM_THREADS);
-    for (int thread = 0; thread < NUM_THREADS; thread++) {
-        concurrent_threads.push_back(std::thread([&](){do_work_concurrent(cuckoo_concurrent, concurrent_entries, &concurrent_metrics);}));
+    concurrent_metrics.reserve(num_threads);
+    for (int thread = 0; thread < num_threads; thread++) {
+        concurrent_threads.push_back(std::thread([&, thread](){do_work_concurrent(cuckoo_concurrent, workload.stream(thread), &concurrent_metrics);}));
     }
-    for (int thread = 0; thread < NUM_THREADS; thread++) {
+    for (int thread = 0; thread < num_threads; thread++) {
         concurrent_threads[thread].join();
     }
     Metrics total_concurrent_metrics = {};
-    if (concurrent_metrics.size() != NUM_THREADS)
+    if (concurrent_metrics.size() != num_threads)
         std::cerr << "Concurrent metrics is incorrect size: " << concurrent_metrics.size() << std::endl;
-    for (int thread = 0; thread < NUM_THREADS; thread++) {
+    for (int thread = 0; thread < num_threads; thread++) {
         double exec_time = (double) concurrent_metrics[thread].exec_time / (double) 1000000;
         std::cout << "Time to execute (milliseconds):\t\t\t" << exec_time << std::endl;
         total_concurrent_metrics.exec_time += (exec_time - total_concurrent_metrics.exec_time) / (thread + 1);
@@ -252,45 +1278,48 @@ int main(int argc, char *argv[]) {
         std::cout << "Concurrent add hit: " << concurrent_metrics[thread].add_hit << std::endl;
         std::cout << "Concurrent add miss: " << concurrent_metrics[thread].add_miss << std::endl;
         std::cout << "Concurrent remove hit: " << concurrent_metrics[thread].remove_hit << std::endl;
-        std::cout << "Concurrent remove miss: " << concurrent_metrics[thread].remove_miss << std::endl << std::endl;
+        std::cout << "Concurrent remove miss: " << concurrent_metrics[thread].remove_miss << std::endl;
+        print_perf("Concurrent", concurrent_metrics[thread].perf, workload.ops_per_stream());
+        std::cout << std::endl;
         total_concurrent_metrics.contains_hit += concurrent_metrics[thread].contains_hit;
         total_concurrent_metrics.contains_miss += concurrent_metrics[thread].contains_miss;
         total_concurrent_metrics.add_hit += concurrent_metrics[thread].add_hit;
         total_concurrent_metrics.add_miss += concurrent_metrics[thread].add_miss;
         total_concurrent_metrics.remove_hit += concurrent_metrics[thread].remove_hit;
         total_concurrent_metrics.remove_miss += concurrent_metrics[thread].remove_miss;
+        total_concurrent_metrics.perf += concurrent_metrics[thread].perf;
     }
-    int concurrent_expected_size = INITIAL_SIZE + total_concurrent_metrics.add_hit - total_concurrent_metrics.remove_hit;
+    int concurrent_expected_size = initial_size + total_concurrent_metrics.add_hit - total_concurrent_metrics.remove_hit;
     assert(concurrent_expected_size == cuckoo_concurrent->size());
     std::cout << "Average concurrent exec_time (milliseconds):\t\t" << total_concurrent_metrics.exec_time << std::endl;
-    std::cout << std::fixed << "Average concurrent total throughput (ops/sec):\t\t" << (double) (NUM_OPS * NUM_THREADS) / (total_concurrent_metrics.exec_time / 1000.0) << std::endl;
+    std::cout << std::fixed << "Average concurrent total throughput (ops/sec):\t\t" << (double) total_ops / (total_concurrent_metrics.exec_time / 1000.0) << std::endl;
     std::cout << "Concurrent total contains hit: " << total_concurrent_metrics.contains_hit << std::endl;
     std::cout << "Concurrent total contains miss: " << total_concurrent_metrics.contains_miss << std::endl;
     std::cout << "Concurrent total add hit: " << total_concurrent_metrics.add_hit << std::endl;
     std::cout << "Concurrent total add miss: " << total_concurrent_metrics.add_miss << std::endl;
     std::cout << "Concurrent total remove hit: " << total_concurrent_metrics.remove_hit << std::endl;
     std::cout << "Concurrent total remove miss: " << total_concurrent_metrics.remove_miss << std::endl;
+    print_perf("Concurrent total", total_concurrent_metrics.perf, total_ops);
     delete cuckoo_concurrent;
 
     // Transactional Cuckoo
     CuckooTransactionalHashSet<int> *cuckoo_transactional = new CuckooTransactionalHashSet<int>(CAPACITY);
-    auto transactional_entries = generate_entries(INITIAL_SIZE);
-    if (!cuckoo_transactional->populate(transactional_entries))
+    if (!cuckoo_transactional->populate(workload.initial_entries()))
         return 0;
     std::vector<std::thread> transactional_threads = std::vector<std::thread>();
-	transactional_threads.reserve(NUM_THREADS);
+	transactional_threads.reserve(num_threads);
     std::vector<Metrics> transactional_metrics = std::vector<Metrics>();
-    transactional_metrics.reserve(NUM_THREADS);
-    for (int thread = 0; thread < NUM_THREADS; thread++) {
-        transactional_threads.push_back(std::thread([&](){do_work_transactional(cuckoo_transactional, transactional_entries, &transactional_metrics);}));
+    transactional_metrics.reserve(num_threads);
+    for (int thread = 0; thread < num_threads; thread++) {
+        transactional_threads.push_back(std::thread([&, thread](){do_work_transactional(cuckoo_transactional, workload.stream(thread), &transactional_metrics);}));
     }
-    for (int thread = 0; thread < NUM_THREADS; thread++) {
+    for (int thread = 0; thread < num_threads; thread++) {
         transactional_threads[thread].join();
     }
     Metrics total_transactional_metrics = {};
-    if (transactional_metrics.size() != NUM_THREADS)
+    if (transactional_metrics.size() != num_threads)
         std::cerr << "Transactional metrics is incorrect size: " << transactional_metrics.size() << std::endl;
-    for (int thread = 0; thread < NUM_THREADS; thread++) {
+    for (int thread = 0; thread < num_threads; thread++) {
         double exec_time = (double) transactional_metrics[thread].exec_time / (double) 1000000;
         std::cout << "Time to execute (milliseconds):\t\t\t" << exec_time << std::endl;
         total_transactional_metrics.exec_time += (exec_time - total_transactional_metrics.exec_time) / (thread + 1);
@@ -299,23 +1328,27 @@ int main(int argc, char *argv[]) {
         std::cout << "Transactional add hit: " << transactional_metrics[thread].add_hit << std::endl;
         std::cout << "Transactional add miss: " << transactional_metrics[thread].add_miss << std::endl;
         std::cout << "Transactional remove hit: " << transactional_metrics[thread].remove_hit << std::endl;
-        std::cout << "Transactional remove miss: " << transactional_metrics[thread].remove_miss << std::endl << std::endl;
+        std::cout << "Transactional remove miss: " << transactional_metrics[thread].remove_miss << std::endl;
+        print_perf("Transactional", transactional_metrics[thread].perf, workload.ops_per_stream());
+        std::cout << std::endl;
         total_transactional_metrics.contains_hit += transactional_metrics[thread].contains_hit;
         total_transactional_metrics.contains_miss += transactional_metrics[thread].contains_miss;
         total_transactional_metrics.add_hit += transactional_metrics[thread].add_hit;
         total_transactional_metrics.add_miss += transactional_metrics[thread].add_miss;
         total_transactional_metrics.remove_hit += transactional_metrics[thread].remove_hit;
         total_transactional_metrics.remove_miss += transactional_metrics[thread].remove_miss;
+        total_transactional_metrics.perf += transactional_metrics[thread].perf;
     }
-    int transactional_expected_size = INITIAL_SIZE + total_transactional_metrics.add_hit - total_transactional_metrics.remove_hit;
+    int transactional_expected_size = initial_size + total_transactional_metrics.add_hit - total_transactional_metrics.remove_hit;
     assert(transactional_expected_size == cuckoo_transactional->size());
     std::cout << "Average Transactional exec_time (milliseconds):\t\t" << total_transactional_metrics.exec_time << std::endl;
-    std::cout << std::fixed << "Average Transactional total throughput (ops/sec):\t\t" << (double) (NUM_OPS * NUM_THREADS) / (total_transactional_metrics.exec_time / 1000.0) << std::endl;
+    std::cout << std::fixed << "Average Transactional total throughput (ops/sec):\t\t" << (double) total_ops / (total_transactional_metrics.exec_time / 1000.0) << std::endl;
     std::cout << "Transactional total contains hit: " << total_transactional_metrics.contains_hit << std::endl;
     std::cout << "Transactional total contains miss: " << total_transactional_metrics.contains_miss << std::endl;
     std::cout << "Transactional total add hit: " << total_transactional_metrics.add_hit << std::endl;
     std::cout << "Transactional total add miss: " << total_transactional_metrics.add_miss << std::endl;
     std::cout << "Transactional total remove hit: " << total_transactional_metrics.remove_hit << std::endl;
     std::cout << "Transactional total remove miss: " << total_transactional_metrics.remove_miss << std::endl;
+    print_perf("Transactional total", total_transactional_metrics.perf, total_ops);
     delete cuckoo_transactional;
 }
\ No newline at end of file
@@ -1,16 +1,21 @@
+#pragma once
+
 #include <vector>
 #include <stdlib.h>
 #include <iostream>
 #include <functional>
 #include <ctime>
 
+#include "cuckoo-common.h"
+
 template <class T>
 class CuckooTransactionalHashSet {
 
     // Wrapper class for entries to allow for nullptr to be the default
     struct Entry {
-        const T val;
-        Entry(T val) : val(val) {}
+        T val;
+        Entry(const T &val) : val(val) {}
+        Entry(T &&val) : val(std::move(val)) {}
     };
 
     int limit;
@@ -18,6 +23,9 @@ class CuckooTransactionalHashSet {
     size_t salt1;
     int capacity;
     bool resizing = false;
+    int count = 0;
+    // Grow once this share of the slots is in use, see max_load_factor()
+    double max_load = 1.0;
     std::vector<std::vector<Entry*>> table;
 
     // Taken from boost hash_combine
@@ -27,14 +35,16 @@ class CuckooTransactionalHashSet {
         seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
     }
 
-    int hash0(const T val) {
+    template <class K>
+    int hash0(const K &val) {
         size_t seed = 0;
         hash_combine(seed, val);
         hash_combine(seed, salt0);
         return seed % capacity;
     }
 
-    int hash1(const T val) {
+    template <class K>
+    int hash1(const K &val) {
         size_t seed = 0;
         hash_combine(seed, val);
         hash_combine(seed, salt1);
@@ -67,11 +77,12 @@ class CuckooTransactionalHashSet {
                 table.push_back(row);
             }
 
-            // Add the elements back into the bigger table
+            // Move the entries into the bigger table. On failure they are
+            // all still owned by old_table.
             [&] {
-                for (auto row : old_table) {
+                for (auto &row : old_table) {
                     for (auto entry : row) {
-                        if (entry != nullptr && !add(entry->val)) {
+                        if (entry != nullptr && place(entry) != nullptr) {
                             done = false;
                             table = old_table;
                             return;
@@ -80,36 +91,75 @@ class CuckooTransactionalHashSet {
                 }
             }();
         } while (!done);
-        for (auto row : old_table) {
-            for (auto entry : row) {
-                if (entry != nullptr)
-                    delete entry;
-            }
-            row.clear();
-        }
         old_table.clear();
         resizing = false;
         return true;
     }
 
-    /** 
-     * Adds val
-     * return: true if add was successful
+    /**
+     * Puts value in the table, displacing entries along its cuckoo path.
+     * Entries move by pointer, keys are never copied.
+     * return: the entry left without a slot, or nullptr if all found one
      */
-    bool add(const Entry *value) {
-        if (contains(value->val)) {
-            return false;
-        }
+    Entry* place(Entry *value) {
         for (int i = 0; i < limit; i++) {
             if ((value = swap(0, hash0(value->val), value)) == nullptr) {
-                return true;
+                return nullptr;
             } else if ((value = swap(1, hash1(value->val), value)) == nullptr) {
-                return true;
+                return nullptr;
             }
         }
-        if (!resize())
+        return value;
+    }
+
+    /**
+     * Adds value, which must not be in the table yet
+     * return: true if add was successful
+     */
+    bool insert(Entry *value) {
+        value = place(value);
+        if (value == nullptr) {
+            count++;
+            if (load_factor() > max_load)
+                resize();
+            return true;
+        }
+        // value is whichever entry was left without a slot
+        if (!resize()) {
+            delete value;
             return false;
-        add(value->val);
+        }
+        return insert(value);
+    }
+
+    template <class K>
+    bool remove_key(const K &val) {
+        int index0 = hash0(val);
+        int index1 = hash1(val);
+        if (table[0][index0] != nullptr && table[0][index0]->val == val) {
+            delete table[0][index0];
+            table[0][index0] = nullptr;
+            count--;
+            return true;
+        } else if (table[1][index1] != nullptr && table[1][index1]->val == val) {
+            delete table[1][index1];
+            table[1][index1] = nullptr;
+            count--;
+            return true;
+        }
+        return false;
+    }
+
+    template <class K>
+    bool contains_key(const K &val) {
+        int index0 = hash0(val);
+        int index1 = hash1(val);
+        if (table[0][index0] != nullptr && table[0][index0]->val == val) {
+            return true;
+        } else if (table[1][index1] != nullptr && table[1][index1]->val == val) {
+            return true;
+        }
+        return false;
     }
 
     public:
@@ -125,7 +175,7 @@ class CuckooTransactionalHashSet {
         }
 
         ~CuckooTransactionalHashSet() {
-            for (auto row : table) {
+            for (auto &row : table) {
                 for (auto entry : row) {
                     if (entry != nullptr) {
                         delete entry;
@@ -150,79 +200,98 @@ class CuckooTransactionalHashSet {
          * Adds val
          * return: true if add was successful
          */
-        bool add(const T val) {
-            if (contains(val)) {
+        bool add(const T &val) {
+            if (contains_key(val))
                 return false;
-            }
-            Entry *value = new Entry(val);
-            for (int i = 0; i < limit; i++) {
-                if ((value = swap(0, hash0(value->val), value)) == nullptr) {
-                    return true;
-                } else if ((value = swap(1, hash1(value->val), value)) == nullptr) {
-                    return true;
-                }
-            }
-            if (!resize())
+            return insert(new Entry(val));
+        }
+
+        bool add(T &&val) {
+            if (contains_key(val))
                 return false;
-            add(value->val);
+            return insert(new Entry(std::move(val)));
+        }
+
+        /**
+         * Builds a value from args and adds it by move. The value is
+         * hashed and compared before it has a slot, so it is not
+         * constructed in place.
+         * return: true if add was successful
+         */
+        template <class... Args>
+        bool emplace(Args&&... args) {
+            return add(T(std::forward<Args>(args)...));
         }
 
         /** 
          * Removes val
          * return: true if remove was successful
          */
-        bool remove(const T val) {
-            int index0 = hash0(val);
-            int index1 = hash1(val);
-            if (table[0][index0] != nullptr && table[0][index0]->val == val) {
-                delete table[0][index0];
-                table[0][index0] = nullptr;
-                return true;
-            } else if (table[1][index1] != nullptr && table[1][index1]->val == val) {
-                delete table[1][index1];
-                table[1][index1] = nullptr;
-                return true;
-            }
-            return false;
+        bool remove(const T &val) {
+            return remove_key(val);
+        }
+
+        /**
+         * Removes the value equal to key, see is_heterogeneous_key
+         * return: true if remove was successful
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool remove(const K &key) {
+            return remove_key(key);
         }
 
         /** 
          * Checks if the table contains val
          * return: true if the table contains val
          */
-        bool contains(const T val) {
-            int index0 = hash0(val);
-            int index1 = hash1(val);
-            if (table[0][index0] != nullptr && table[0][index0]->val == val) {
-                return true;
-            } else if (table[1][index1] != nullptr && table[1][index1]->val == val) {
-                return true;
-            }
-            return false;
+        bool contains(const T &val) {
+            return contains_key(val);
+        }
+
+        /**
+         * Checks if the table contains a value equal to key, see
+         * is_heterogeneous_key
+         * return: true if the table contains it
+         */
+        template <class K, enable_if_heterogeneous_t<T, K> = 0>
+        bool contains(const K &key) {
+            return contains_key(key);
         }
 
         /**
-         * Counts the number of elements in the table
          * return: The number of elements in the table
          */
         int size() {
-            int size = 0;
-            for (auto row : table) {
-                for (auto entry : row) {
-                    if (entry != nullptr) {
-                        size++;
-                    }
-                }
-            }
-            return size;
+            return count;
+        }
+
+        /**
+         * return: The share of the table's slots in use
+         */
+        double load_factor() {
+            return (double) count / (2.0 * capacity);
+        }
+
+        double max_load_factor() {
+            return max_load;
+        }
+
+        /**
+         * Makes add grow the table as soon as the load factor passes
+         * max_load_factor, instead of only once displacement fails. Cuckoo
+         * tables with one slot per index fill to about 0.5. The default of
+         * 1.0 never triggers.
+         */
+        void max_load_factor(double max_load_factor) {
+            max_load = max_load_factor;
         }
 
         /**
          * Populates the table to some predetermined size
          * return: true if successful
          */
-        bool populate(const std::vector<T> entries) {
-            for (T entry : entries) {
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
                 if (!add(entry)) {
                     std::cout << "Duplicate entry attempted for populate!" << std::endl;
                     return false;
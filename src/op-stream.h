@@ -0,0 +1,266 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <cstdint>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Pre-generated benchmark workload in a compact binary format. Each operation
+ * is one 32-bit word: the key in the upper 30 bits and the operation type in
+ * the lower 2. A workload holds the initial entries used to populate the set
+ * and one stream of operations per worker, laid out exactly as in the file,
+ * so a saved workload can be memory-mapped and handed to workers as
+ * read-only slices without any copying.
+ */
+
+enum OpType : uint32_t { OP_CONTAINS = 0, OP_ADD = 1, OP_REMOVE = 2 };
+
+const int OP_TYPE_BITS = 2;
+const uint32_t OP_TYPE_MASK = (1u << OP_TYPE_BITS) - 1;
+const int OP_KEY_MAX = (1 << (32 - OP_TYPE_BITS)) - 1;
+
+inline uint32_t pack_op(int key, uint32_t type) {
+    return ((uint32_t) key << OP_TYPE_BITS) | type;
+}
+
+inline int op_key(uint32_t op) {
+    return (int) (op >> OP_TYPE_BITS);
+}
+
+inline uint32_t op_type(uint32_t op) {
+    return op & OP_TYPE_MASK;
+}
+
+/**
+ * A read-only view of one worker's operations
+ */
+struct OpSlice {
+    const uint32_t *ops = nullptr;
+    size_t count = 0;
+
+    const uint32_t *begin() const { return ops; }
+    const uint32_t *end() const { return ops + count; }
+    size_t size() const { return count; }
+};
+
+class Workload {
+    static const uint32_t MAGIC = 0x4b435543; // "CUCK"
+    static const uint32_t VERSION = 1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t num_streams;
+        uint32_t initial_size;
+        uint32_t key_max;
+        uint32_t write_pct;
+        uint64_t ops_per_stream;
+        uint64_t seed;
+    };
+    static_assert(sizeof(Header) % sizeof(uint32_t) == 0, "header must be whole words");
+    static const size_t HEADER_WORDS = sizeof(Header) / sizeof(uint32_t);
+
+    // Header, initial entries, then the streams back to back. Backed by
+    // owned when generated and by mapping when loaded from a file.
+    std::vector<uint32_t> owned;
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+    const uint32_t *words = nullptr;
+
+    const Header &header() const {
+        return *reinterpret_cast<const Header*>(words);
+    }
+
+    const uint32_t *entries() const {
+        return words + HEADER_WORDS;
+    }
+
+    static size_t total_words(const Header &h) {
+        return HEADER_WORDS + h.initial_size + h.num_streams * h.ops_per_stream;
+    }
+
+    /**
+     * Fills one stream. Removes pick from a fixed-size pool that starts as
+     * the initial entries and has a random member replaced by every add, so
+     * they mostly target present keys without the pool growing.
+     */
+    static void generate_stream(uint32_t *out, const Header &h, const uint32_t *initial, int stream) {
+        std::mt19937_64 generator(h.seed + 1 + stream);
+        std::uniform_int_distribution<int> distribution_percentage(0, 99);
+        std::uniform_int_distribution<int> distribution_entries(0, h.key_max);
+        std::vector<int> pool(initial, initial + h.initial_size);
+        if (pool.empty())
+            pool.push_back(0);
+        std::uniform_int_distribution<size_t> distribution_pool(0, pool.size() - 1);
+        int write_pct = h.write_pct;
+        for (uint64_t i = 0; i < h.ops_per_stream; i++) {
+            int which_op = distribution_percentage(generator);
+            if (which_op < 100 - write_pct) {
+                out[i] = pack_op(distribution_entries(generator), OP_CONTAINS);
+            } else if (which_op < 100 - write_pct / 2) {
+                int entry = distribution_entries(generator);
+                pool[distribution_pool(generator)] = entry;
+                out[i] = pack_op(entry, OP_ADD);
+            } else {
+                out[i] = pack_op(pool[distribution_pool(generator)], OP_REMOVE);
+            }
+        }
+    }
+
+    void release() {
+        if (mapping != nullptr)
+            munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+        owned.clear();
+        owned.shrink_to_fit();
+        words = nullptr;
+    }
+
+    public:
+        Workload() {}
+
+        ~Workload() {
+            release();
+        }
+
+        Workload(const Workload&) = delete;
+        Workload& operator=(const Workload&) = delete;
+
+        /**
+         * Generates initial_size unique entries and num_streams streams of
+         * ops_per_stream operations, write_pct of them split evenly between
+         * add and remove. Streams are generated in parallel; the result only
+         * depends on the arguments.
+         * return: true if successful
+         */
+        bool generate(int num_streams, size_t ops_per_stream, int initial_size, int key_max, int write_pct, uint64_t seed) {
+            if (key_max > OP_KEY_MAX || initial_size > key_max + 1) {
+                std::cerr << "Workload keys must fit in " << (32 - OP_TYPE_BITS) << " bits" << std::endl;
+                return false;
+            }
+            release();
+            Header h = {MAGIC, VERSION, (uint32_t) num_streams, (uint32_t) initial_size, (uint32_t) key_max,
+                        (uint32_t) write_pct, (uint64_t) ops_per_stream, seed};
+            owned.resize(total_words(h));
+            memcpy(owned.data(), &h, sizeof(h));
+            words = owned.data();
+
+            std::mt19937_64 generator(seed);
+            std::uniform_int_distribution<int> entry_generator(0, key_max);
+            std::unordered_set<int> unique;
+            uint32_t *initial = owned.data() + HEADER_WORDS;
+            while ((int) unique.size() < initial_size) {
+                int entry = entry_generator(generator);
+                if (unique.insert(entry).second)
+                    initial[unique.size() - 1] = entry;
+            }
+
+            std::vector<std::thread> threads;
+            for (int stream = 0; stream < num_streams; stream++) {
+                uint32_t *out = initial + initial_size + stream * ops_per_stream;
+                threads.push_back(std::thread([=, &h]() { generate_stream(out, h, initial, stream); }));
+            }
+            for (auto &thread : threads)
+                thread.join();
+            return true;
+        }
+
+        /**
+         * Writes the workload to path
+         * return: true if successful
+         */
+        bool save(const char *path) const {
+            FILE *file = fopen(path, "wb");
+            if (file == nullptr) {
+                perror(path);
+                return false;
+            }
+            size_t count = total_words(header());
+            bool ok = fwrite(words, sizeof(uint32_t), count, file) == count;
+            ok = fclose(file) == 0 && ok;
+            if (!ok)
+                perror(path);
+            return ok;
+        }
+
+        /**
+         * Memory-maps a workload written by save()
+         * return: true if successful
+         */
+        bool load(const char *path) {
+            release();
+            int fd = open(path, O_RDONLY);
+            if (fd < 0) {
+                perror(path);
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)) {
+                std::cerr << path << ": not a workload file" << std::endl;
+                close(fd);
+                return false;
+            }
+            mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                perror(path);
+                return false;
+            }
+            mapping_size = st.st_size;
+            words = static_cast<const uint32_t*>(mapping);
+            const Header &h = header();
+            if (h.magic != MAGIC || h.version != VERSION || total_words(h) * sizeof(uint32_t) != mapping_size) {
+                std::cerr << path << ": not a workload file" << std::endl;
+                release();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * return: a copy of the initial entries, for populate()
+         */
+        std::vector<int> initial_entries() const {
+            return std::vector<int>(entries(), entries() + header().initial_size);
+        }
+
+        OpSlice stream(int index) const {
+            OpSlice slice;
+            slice.ops = entries() + header().initial_size + index * header().ops_per_stream;
+            slice.count = header().ops_per_stream;
+            return slice;
+        }
+
+        /**
+         * return: every stream as one slice, for running a workload serially
+         */
+        OpSlice all_streams() const {
+            OpSlice slice = stream(0);
+            slice.count = header().num_streams * header().ops_per_stream;
+            return slice;
+        }
+
+        int num_streams() const {
+            return header().num_streams;
+        }
+
+        size_t ops_per_stream() const {
+            return header().ops_per_stream;
+        }
+
+        int initial_size() const {
+            return header().initial_size;
+        }
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <cstdint>
+#include <memory>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+
+/**
+ * One hardware counter of the calling thread, read through perf_event_open.
+ * Opening fails quietly where perf events are not allowed (containers,
+ * perf_event_paranoid); available() then reports false and value() 0.
+ * When more counters are open than the PMU has, the kernel time-shares them
+ * and value() scales the count up to the whole enabled time.
+ */
+class PerfCounter {
+    int fd = -1;
+
+    public:
+        /**
+         * user_only: count only while the thread runs in user space, which
+         * is all perf_event_paranoid 2 allows
+         */
+        PerfCounter(uint32_t type, uint64_t config, bool user_only = true) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = user_only;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        ~PerfCounter() {
+            if (fd >= 0)
+                close(fd);
+        }
+
+        PerfCounter(const PerfCounter&) = delete;
+        PerfCounter& operator=(const PerfCounter&) = delete;
+
+        bool available() {
+            return fd >= 0;
+        }
+
+        void start() {
+            if (fd < 0)
+                return;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+        void stop() {
+            if (fd >= 0)
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+
+        /**
+         * return: the count between the last start() and stop()
+         */
+        uint64_t value() {
+            // count, time enabled, time running
+            uint64_t values[3] = {0, 0, 0};
+            if (fd < 0 || read(fd, values, sizeof(values)) != sizeof(values))
+                return 0;
+            if (values[2] == 0)
+                return 0;
+            if (values[2] < values[1])
+                return (uint64_t) ((double) values[0] * values[1] / values[2]);
+            return values[0];
+        }
+};
+
+/**
+ * Read misses of cache, one of PERF_COUNT_HW_CACHE_*
+ */
+inline uint64_t cache_miss_config(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+/**
+ * Data TLB load misses
+ */
+inline uint64_t dtlb_load_misses_config() {
+    return cache_miss_config(PERF_COUNT_HW_CACHE_DTLB);
+}
+
+/**
+ * The events PerfCounterSet captures
+ */
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    NUM_PERF_EVENTS
+};
+
+const char *const PERF_EVENT_NAMES[NUM_PERF_EVENTS] = {
+    "cycles", "instructions", "l1d_miss", "llc_miss", "dtlb_miss", "branch_miss", "ctx_switch"
+};
+
+/**
+ * Counts of each PerfEvent over some phase, summed over the threads that ran
+ * it. An event no thread could open stays unavailable.
+ */
+struct PerfSample {
+    uint64_t counts[NUM_PERF_EVENTS] = {};
+    bool available[NUM_PERF_EVENTS] = {};
+
+    PerfSample &operator+=(const PerfSample &other) {
+        for (int event = 0; event < NUM_PERF_EVENTS; event++) {
+            counts[event] += other.counts[event];
+            available[event] = available[event] || other.available[event];
+        }
+        return *this;
+    }
+
+    /**
+     * return: true if any perf_event counter opened. Context switches do not
+     * count, they are always available through getrusage.
+     */
+    bool any_hardware() const {
+        for (int event = 0; event < NUM_PERF_EVENTS; event++) {
+            if (event != PERF_CONTEXT_SWITCHES && available[event])
+                return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * Every PerfEvent for the calling thread. Construct, start and stop it on the
+ * thread to be measured. Events the kernel or hardware refuses are left out,
+ * except context switches, which fall back to getrusage.
+ */
+class PerfCounterSet {
+    std::unique_ptr<PerfCounter> counters[NUM_PERF_EVENTS];
+    // Voluntary plus involuntary switches of the thread so far
+    uint64_t rusage_switches = 0;
+
+    static uint64_t thread_switches() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) != 0)
+            return 0;
+        return usage.ru_nvcsw + usage.ru_nivcsw;
+    }
+
+    public:
+        PerfCounterSet() {
+            counters[PERF_CYCLES].reset(new PerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES));
+            counters[PERF_INSTRUCTIONS].reset(new PerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS));
+            counters[PERF_L1D_MISSES].reset(new PerfCounter(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_L1D)));
+            counters[PERF_LLC_MISSES].reset(new PerfCounter(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_LL)));
+            counters[PERF_DTLB_MISSES].reset(new PerfCounter(PERF_TYPE_HW_CACHE, dtlb_load_misses_config()));
+            counters[PERF_BRANCH_MISSES].reset(new PerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES));
+            // Switches happen in the kernel, a user-only count is always 0
+            counters[PERF_CONTEXT_SWITCHES].reset(new PerfCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false));
+        }
+
+        void start() {
+            rusage_switches = thread_switches();
+            for (auto &counter : counters)
+                counter->start();
+        }
+
+        void stop() {
+            for (auto &counter : counters)
+                counter->stop();
+            rusage_switches = thread_switches() - rusage_switches;
+        }
+
+        /**
+         * return: the counts between the last start() and stop()
+         */
+        PerfSample sample() {
+            PerfSample sample;
+            for (int event = 0; event < NUM_PERF_EVENTS; event++) {
+                sample.available[event] = counters[event]->available();
+                sample.counts[event] = counters[event]->value();
+            }
+            if (!sample.available[PERF_CONTEXT_SWITCHES]) {
+                sample.available[PERF_CONTEXT_SWITCHES] = true;
+                sample.counts[PERF_CONTEXT_SWITCHES] = rusage_switches;
+            }
+            return sample;
+        }
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * Order in which benchmark threads are placed on hardware threads
+ */
+enum class PinPolicy {
+    // Leave placement to the scheduler
+    None,
+    // One thread per physical core, filling a socket before the next; SMT
+    // siblings only once every core has a thread
+    Compact,
+    // One thread per physical core, round-robin across sockets; SMT siblings
+    // last
+    Scatter,
+    // Both hardware threads of a core before moving to the next core
+    SmtFirst
+};
+
+struct CpuInfo {
+    int cpu;
+    int package;
+    int core;
+    // Position of this cpu among the hardware threads of its core
+    int sibling;
+    // Position of this core among the cores of its package
+    int core_rank;
+};
+
+inline bool parse_pin_policy(const std::string &name, PinPolicy &policy) {
+    if (name == "none") policy = PinPolicy::None;
+    else if (name == "compact") policy = PinPolicy::Compact;
+    else if (name == "scatter") policy = PinPolicy::Scatter;
+    else if (name == "smt") policy = PinPolicy::SmtFirst;
+    else return false;
+    return true;
+}
+
+inline int read_topology(int cpu, const char *field) {
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + field);
+    int value = 0;
+    if (!(file >> value))
+        return 0;
+    return value;
+}
+
+/**
+ * Lists the cpus this process may run on, in the order a policy fills them
+ */
+inline std::vector<int> cpu_order(PinPolicy policy) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    std::vector<CpuInfo> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed))
+            cpus.push_back({cpu, read_topology(cpu, "physical_package_id"), read_topology(cpu, "core_id"), 0, 0});
+    }
+
+    // Rank siblings within a core and cores within a package
+    std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b) {
+        if (a.package != b.package) return a.package < b.package;
+        if (a.core != b.core) return a.core < b.core;
+        return a.cpu < b.cpu;
+    });
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (i == 0) continue;
+        const CpuInfo &prev = cpus[i - 1];
+        if (cpus[i].package == prev.package && cpus[i].core == prev.core) {
+            cpus[i].sibling = prev.sibling + 1;
+            cpus[i].core_rank = prev.core_rank;
+        } else if (cpus[i].package == prev.package) {
+            cpus[i].core_rank = prev.core_rank + 1;
+        }
+    }
+
+    switch (policy) {
+        case PinPolicy::Compact:
+            std::stable_sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b) {
+                if (a.sibling != b.sibling) return a.sibling < b.sibling;
+                if (a.package != b.package) return a.package < b.package;
+                return a.core_rank < b.core_rank;
+            });
+            break;
+        case PinPolicy::Scatter:
+            std::stable_sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b) {
+                if (a.sibling != b.sibling) return a.sibling < b.sibling;
+                if (a.core_rank != b.core_rank) return a.core_rank < b.core_rank;
+                return a.package < b.package;
+            });
+            break;
+        default:
+            // Already in package, core, sibling order
+            break;
+    }
+    std::vector<int> order;
+    for (auto &info : cpus)
+        order.push_back(info.cpu);
+    return order;
+}
+
+/**
+ * Pins the calling thread to cpu
+ * return: true if successful
+ */
+inline bool pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/**
+ * Holds workers until all of them are ready, then releases them together
+ */
+class StartBarrier {
+    std::atomic<int> ready;
+    std::atomic<bool> go;
+
+    public:
+        StartBarrier() : ready(0), go(false) {}
+
+        /**
+         * Called by each worker once its setup is done
+         */
+        void arrive_and_wait() {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+
+        /**
+         * Called by the coordinator; returns once every worker is waiting
+         */
+        void wait_for(int workers) {
+            while (ready.load() < workers)
+                std::this_thread::yield();
+        }
+
+        void release() {
+            go.store(true, std::memory_order_release);
+        }
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include <iostream>
+#include <unordered_set>
+#include <mutex>
+
+/**
+ * std::unordered_set behind the cuckoo set interface, as a baseline
+ */
+template <class T>
+class StdUnorderedSet {
+    std::unordered_set<T> set;
+
+    public:
+        StdUnorderedSet(int capacity) {
+            set.reserve(capacity);
+        }
+
+        bool add(const T &val) {
+            return set.insert(val).second;
+        }
+
+        bool add(T &&val) {
+            return set.insert(std::move(val)).second;
+        }
+
+        bool remove(const T &val) {
+            return set.erase(val) != 0;
+        }
+
+        bool contains(const T &val) {
+            return set.find(val) != set.end();
+        }
+
+        int size() {
+            return set.size();
+        }
+
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
+                if (!add(entry)) {
+                    std::cout << "Duplicate entry attempted for populate!" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+};
+
+/**
+ * std::unordered_set guarded by a single mutex, the simplest thread-safe
+ * baseline
+ */
+template <class T>
+class LockedUnorderedSet {
+    std::unordered_set<T> set;
+    std::mutex lock;
+
+    public:
+        LockedUnorderedSet(int capacity) {
+            set.reserve(capacity);
+        }
+
+        bool add(const T &val) {
+            std::lock_guard<std::mutex> guard(lock);
+            return set.insert(val).second;
+        }
+
+        bool add(T &&val) {
+            std::lock_guard<std::mutex> guard(lock);
+            return set.insert(std::move(val)).second;
+        }
+
+        bool remove(const T &val) {
+            std::lock_guard<std::mutex> guard(lock);
+            return set.erase(val) != 0;
+        }
+
+        bool contains(const T &val) {
+            std::lock_guard<std::mutex> guard(lock);
+            return set.find(val) != set.end();
+        }
+
+        /**
+         * Thread non-safe!
+         */
+        int size() {
+            return set.size();
+        }
+
+        /**
+         * Thread non-safe!
+         */
+        bool populate(const std::vector<T> &entries) {
+            for (const T &entry : entries) {
+                if (!add(entry)) {
+                    std::cout << "Duplicate entry attempted for populate!" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+};